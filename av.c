@@ -40,6 +40,13 @@ static int le_av_file;
 static int le_av_strm;
 static int le_gd = -1;
 
+static void av_init_scaler_cache(uint32_t size);
+static void av_free_scaler_cache(void);
+static void av_release_scaler(struct SwsContext *scaler_cxt, const av_scaler_key *key);
+static void av_print_scaler_cache_info(void);
+static void av_free_slice_pool(av_slice_pool *pool);
+static void av_free_shared_frame_ring(av_shared_frame_ring *ring);
+
 /* {{{ arginfo */
 ZEND_BEGIN_ARG_INFO_EX(arginfo_av_file_open, 0, 0, 2)
     ZEND_ARG_INFO(0, path)
@@ -68,6 +75,14 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_av_file_optimize, 0, 0, 1)
 	ZEND_ARG_INFO(0, path)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_file_extract_thumbnails, 0, 0, 4)
+	ZEND_ARG_INFO(0, file)
+	ZEND_ARG_INFO(0, count)
+	ZEND_ARG_INFO(0, width)
+	ZEND_ARG_INFO(0, height)
+	ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_open, 0, 0, 2)
     ZEND_ARG_INFO(0, file)
     ZEND_ARG_INFO(0, id)
@@ -84,10 +99,49 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_read_image, 0, 0, 2)
     ZEND_ARG_INFO(1, time)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_read_images, 0, 0, 2)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, images)
+    ZEND_ARG_INFO(0, callback)
+    ZEND_ARG_INFO(0, count)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_read_frame, 0, 0, 1)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_read_pcm, 0, 0, 2)
     ZEND_ARG_INFO(0, stream)
     ZEND_ARG_INFO(1, buffer)
     ZEND_ARG_INFO(1, time)
+    ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_analyze_audio, 0, 0, 1)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_waveform, 0, 0, 2)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, buckets)
+    ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_fingerprint, 0, 0, 1)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_hash_frames, 0, 0, 1)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_read_frame_info, 0, 0, 1)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, options)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_read_subtitle, 0, 0, 3)
@@ -102,6 +156,13 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_write_image, 0, 0, 2)
     ZEND_ARG_INFO(0, time)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_write_frame, 0, 0, 2)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, planes)
+    ZEND_ARG_INFO(0, options)
+    ZEND_ARG_INFO(0, time)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_av_stream_write_pcm, 0, 0, 2)
     ZEND_ARG_INFO(0, stream)
     ZEND_ARG_INFO(0, buffer)
@@ -132,13 +193,22 @@ const zend_function_entry av_functions[] = {
 	PHP_FE(av_file_eof,					arginfo_av_file_eof)
 	PHP_FE(av_file_stat,				arginfo_av_file_stat)
 	PHP_FE(av_file_optimize,			arginfo_av_file_optimize)
+	PHP_FE(av_file_extract_thumbnails,	arginfo_av_file_extract_thumbnails)
 
 	PHP_FE(av_stream_open,				arginfo_av_stream_open)
 	PHP_FE(av_stream_close,				arginfo_av_stream_close)
 	PHP_FE(av_stream_read_image,		arginfo_av_stream_read_image)
+	PHP_FE(av_stream_read_images,		arginfo_av_stream_read_images)
+	PHP_FE(av_stream_read_frame,		arginfo_av_stream_read_frame)
 	PHP_FE(av_stream_read_pcm,			arginfo_av_stream_read_pcm)
 	PHP_FE(av_stream_read_subtitle,		arginfo_av_stream_read_subtitle)
+	PHP_FE(av_stream_analyze_audio,		arginfo_av_stream_analyze_audio)
+	PHP_FE(av_stream_waveform,			arginfo_av_stream_waveform)
+	PHP_FE(av_stream_fingerprint,		arginfo_av_stream_fingerprint)
+	PHP_FE(av_stream_hash_frames,		arginfo_av_stream_hash_frames)
+	PHP_FE(av_stream_read_frame_info,	arginfo_av_stream_read_frame_info)
 	PHP_FE(av_stream_write_image,		arginfo_av_stream_write_image)
+	PHP_FE(av_stream_write_frame,		arginfo_av_stream_write_frame)
 	PHP_FE(av_stream_write_pcm,			arginfo_av_stream_write_pcm)
 	PHP_FE(av_stream_write_subtitle,	arginfo_av_stream_write_subtitle)
 
@@ -185,6 +255,8 @@ PHP_INI_BEGIN()
 	STD_PHP_INI_ENTRY("av.max_threads_per_stream", "2", PHP_INI_SYSTEM, OnUpdateLong, max_threads_per_stream, zend_av_globals, av_globals)
     STD_PHP_INI_ENTRY("av.threads_per_video_stream", "2", PHP_INI_ALL, OnUpdateLong, threads_per_video_stream, zend_av_globals, av_globals)
     STD_PHP_INI_ENTRY("av.threads_per_audio_stream", "2", PHP_INI_ALL, OnUpdateLong, threads_per_audio_stream, zend_av_globals, av_globals)
+	STD_PHP_INI_ENTRY("av.scaler_cache_size", STRING(AV_SCALER_CACHE_DEFAULT_SIZE), PHP_INI_SYSTEM, OnUpdateLong, scaler_cache_size, zend_av_globals, av_globals)
+	STD_PHP_INI_ENTRY("av.simd", "1", PHP_INI_SYSTEM, OnUpdateString, simd, zend_av_globals, av_globals)
 PHP_INI_END()
 /* }}} */
 
@@ -197,6 +269,8 @@ static void php_av_init_globals(zend_av_globals *av_globals)
 	av_globals->max_threads_per_stream = 2;
 	av_globals->threads_per_video_stream = 2;
 	av_globals->threads_per_audio_stream = 2;
+	av_globals->scaler_cache_size = AV_SCALER_CACHE_DEFAULT_SIZE;
+	av_globals->simd = NULL;
 }
 /* }}} */
 
@@ -209,6 +283,8 @@ static int av_is_qt_format(AVOutputFormat *of) {
 }
 
 static int av_flush_pending_packets(av_file *file);
+static void av_pause_prefetch(av_file *file);
+static void av_stop_prefetch(av_file *file);
 
 #ifndef HAVE_AVCODEC_FREE_FRAME
 void avcodec_free_frame(AVFrame **frame)
@@ -225,6 +301,13 @@ static void av_free_file(av_file *file) {
 	// don't free anything until all streams are closed
 	if(file->open_stream_count == 0) {
 		uint32_t i = 0, j = 0;
+		if(file->prefetch_queue) {
+			av_stop_prefetch(file);
+			av_mutex_destroy(&file->prefetch_mutex);
+			av_cond_destroy(&file->prefetch_not_empty);
+			av_cond_destroy(&file->prefetch_not_full);
+			efree(file->prefetch_queue);
+		}
 		if(file->flags & AV_FILE_WRITE) {
 			av_flush_pending_packets(file);
 			if(file->flags & AV_FILE_HEADER_WRITTEN) {
@@ -253,8 +336,17 @@ static void av_free_file(av_file *file) {
 					avpicture_free((AVPicture *) strm->picture);
 					avcodec_free_frame(&strm->picture);
 				}
-				if(strm->scaler_cxt) {	// buffer for planar to interleave conversion
-					sws_freeContext(strm->scaler_cxt);
+				if(strm->slice_pool) {
+					av_free_slice_pool(strm->slice_pool);
+				}
+				if(strm->shared_frames) {
+					av_free_shared_frame_ring(strm->shared_frames);
+				}
+				if(strm->shared_memory_name) {
+					efree(strm->shared_memory_name);
+				}
+				if(strm->scaler_cxt) {
+					av_release_scaler(strm->scaler_cxt, &strm->scaler_key);
 				}
 				if(strm->resampler_cxt) {
 #if defined(HAVE_SWRESAMPLE)
@@ -278,8 +370,9 @@ static void av_free_file(av_file *file) {
 				}
 				if(strm->packet_queue) {
 					for(j = 0; j < strm->packet_count; j++) {
-						av_free_packet(strm->packet_queue[j]);
-						efree(strm->packet_queue[j]);
+						AVPacket *packet = strm->packet_queue[(strm->packet_queue_head + j) & (strm->packet_queue_size - 1)];
+						av_free_packet(packet);
+						efree(packet);
 					}
 					efree(strm->packet_queue);
 				}
@@ -292,6 +385,12 @@ static void av_free_file(av_file *file) {
 		if(file->streams) {
 			efree(file->streams);
 		}
+		if(file->packet_pool) {
+			for(i = 0; i < file->packet_pool_count; i++) {
+				efree(file->packet_pool[i]);
+			}
+			efree(file->packet_pool);
+		}
 		if(file->flags & AV_FILE_WRITE) {
 			TSRMLS_FETCH();
 			if(AV_G(optimize_output)) {
@@ -310,6 +409,7 @@ static void av_free_file(av_file *file) {
 }
 
 static void av_flush_remaining_frames(av_stream *strm);
+static void av_set_stream_discard(av_stream *strm, int discard);
 
 static void av_free_stream(av_stream *strm) {
 	if(!(strm->flags & AV_STREAM_FREED)) {
@@ -319,6 +419,9 @@ static void av_free_stream(av_stream *strm) {
 			if(file->flags & AV_FILE_HEADER_WRITTEN) {
 				av_flush_remaining_frames(strm);
 			}
+		} else if(!(file->flags & AV_FILE_FREED)) {
+			// stop demuxing packets for the stream until it's opened again
+			av_set_stream_discard(strm, TRUE);
 		}
 		strm->flags |= AV_STREAM_FREED;
 		if(file->open_stream_count == 0) {
@@ -351,30 +454,101 @@ static int av_get_stream_type(const char *type TSRMLS_DC) {
 	}
 }
 
+static int av_get_scaling_flags(const char *name TSRMLS_DC) {
+	static const struct {
+		const char *name;
+		int flags;
+	} algorithms[] = {
+		{ "fast_bilinear",	SWS_FAST_BILINEAR },
+		{ "bilinear",		SWS_BILINEAR },
+		{ "bicubic",		SWS_BICUBIC },
+		{ "bicublin",		SWS_BICUBLIN },
+		{ "point",			SWS_POINT },
+		{ "area",			SWS_AREA },
+		{ "gauss",			SWS_GAUSS },
+		{ "sinc",			SWS_SINC },
+		{ "lanczos",		SWS_LANCZOS },
+		{ "spline",			SWS_SPLINE },
+		{ "experimental",	SWS_X },
+	};
+	uint32_t i;
+	for(i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); i++) {
+		if(strcmp(name, algorithms[i].name) == 0) {
+			return algorithms[i].flags;
+		}
+	}
+	php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a recognized scaling algorithm", name);
+	return -1;
+}
+
+static AVPacket *av_acquire_packet(av_file *file) {
+	AVPacket *packet;
+	if(file->packet_pool_count > 0) {
+		packet = file->packet_pool[--file->packet_pool_count];
+		file->packet_pool_hits++;
+	} else {
+		packet = emalloc(sizeof(AVPacket));
+		file->packet_pool_misses++;
+	}
+	av_init_packet(packet);
+	packet->data = NULL;
+	packet->size = 0;
+	return packet;
+}
+
+static void av_release_packet(av_file *file, AVPacket *packet) {
+	av_free_packet(packet);
+	if(!file->packet_pool) {
+		file->packet_pool = emalloc(sizeof(AVPacket *) * AV_PACKET_POOL_SIZE);
+	}
+	if(file->packet_pool_count < AV_PACKET_POOL_SIZE) {
+		file->packet_pool[file->packet_pool_count++] = packet;
+	} else {
+		efree(packet);
+	}
+}
+
 static void av_push_packet(av_stream *strm, AVPacket *packet) {
+	uint32_t tail;
 	if(!strm->packet) {
 		strm->packet = packet;
 		strm->packet_bytes_remaining = packet->size;
 		return;
 	}
 	if(strm->packet_count >= strm->packet_queue_size) {
-		strm->packet_queue_size += 16;
-		strm->packet_queue = erealloc(strm->packet_queue, sizeof(AVPacket *) * strm->packet_queue_size);
+		// double the capacity, moving the packets so they're contiguous again
+		uint32_t new_queue_size = (strm->packet_queue_size) ? strm->packet_queue_size * 2 : AV_PACKET_QUEUE_INITIAL_SIZE;
+		AVPacket **new_queue = emalloc(sizeof(AVPacket *) * new_queue_size);
+		uint32_t i;
+		for(i = 0; i < strm->packet_count; i++) {
+			new_queue[i] = strm->packet_queue[(strm->packet_queue_head + i) & (strm->packet_queue_size - 1)];
+		}
+		if(strm->packet_queue) {
+			efree(strm->packet_queue);
+		}
+		strm->packet_queue = new_queue;
+		strm->packet_queue_size = new_queue_size;
+		strm->packet_queue_head = 0;
 	}
-	strm->packet_queue[strm->packet_count] = packet;
+	tail = (strm->packet_queue_head + strm->packet_count) & (strm->packet_queue_size - 1);
+	strm->packet_queue[tail] = packet;
+	strm->packet_queue_bytes += packet->size;
 	strm->packet_count++;
+	if(strm->packet_count > strm->packet_count_max) {
+		strm->packet_count_max = strm->packet_count;
+	}
 }
 
 static int av_shift_packet(av_stream *strm) {
 	if(strm->packet) {
-		av_free_packet(strm->packet);
-		efree(strm->packet);
+		av_release_packet(strm->file, strm->packet);
 	}
 	if(strm->packet_count > 0) {
-		strm->packet = strm->packet_queue[0];
+		strm->packet = strm->packet_queue[strm->packet_queue_head];
 		strm->packet_bytes_remaining = strm->packet->size;
+		strm->packet_queue_bytes -= strm->packet->size;
+		strm->packet_queue_head = (strm->packet_queue_head + 1) & (strm->packet_queue_size - 1);
 		strm->packet_count--;
-		memmove(&strm->packet_queue[0], &strm->packet_queue[1], sizeof(AVPacket *) * strm->packet_count);
 		return TRUE;
 	} else {
 		strm->packet = NULL;
@@ -382,6 +556,143 @@ static int av_shift_packet(av_stream *strm) {
 	}
 }
 
+static void av_set_stream_discard(av_stream *strm, int discard) {
+	enum AVDiscard value;
+	if(discard) {
+		// tell the demuxer to skip the stream and drop what has been queued
+		value = AVDISCARD_ALL;
+		strm->flags |= AV_STREAM_DISCARDING;
+		while(strm->packet) {
+			av_shift_packet(strm);
+		}
+	} else {
+		value = (strm->flags & AV_STREAM_KEYFRAMES_ONLY) ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+		strm->flags &= ~AV_STREAM_DISCARDING;
+	}
+	if(strm->stream->discard != value) {
+		// the demuxer looks at the discard setting while it reads
+		av_pause_prefetch(strm->file);
+		strm->stream->discard = value;
+	}
+}
+
+static int av_prefetch_interrupt(void *opaque) {
+	av_file *file = opaque;
+	return file->prefetch_stop;
+}
+
+static AV_THREAD_PROC(av_prefetch_proc, arg) {
+	av_file *file = arg;
+	av_mutex_lock(&file->prefetch_mutex);
+	while(!file->prefetch_stop && !file->prefetch_pause) {
+		AVPacket packet;
+		int result;
+
+		// wait for the decoding side to catch up
+		if(file->prefetch_count >= file->prefetch_queue_size || (file->prefetch_byte_limit && file->prefetch_bytes >= file->prefetch_byte_limit)) {
+			av_cond_wait(&file->prefetch_not_full, &file->prefetch_mutex);
+			continue;
+		}
+		av_mutex_unlock(&file->prefetch_mutex);
+
+		av_init_packet(&packet);
+		packet.data = NULL;
+		packet.size = 0;
+		result = av_read_frame(file->format_cxt, &packet);
+		if(result >= 0) {
+			// the packet might point into the demuxer's buffer
+			av_dup_packet(&packet);
+		}
+
+		av_mutex_lock(&file->prefetch_mutex);
+		if(result < 0) {
+			file->prefetch_eof = TRUE;
+			av_cond_signal(&file->prefetch_not_empty);
+			break;
+		}
+		file->prefetch_queue[(file->prefetch_queue_head + file->prefetch_count) & (file->prefetch_queue_size - 1)] = packet;
+		file->prefetch_count++;
+		file->prefetch_bytes += packet.size;
+		av_cond_signal(&file->prefetch_not_empty);
+	}
+	av_mutex_unlock(&file->prefetch_mutex);
+	AV_THREAD_RETURN;
+}
+
+static void av_start_prefetch(av_file *file) {
+	if(!(file->flags & AV_FILE_PREFETCHING)) {
+		file->prefetch_stop = FALSE;
+		file->prefetch_eof = FALSE;
+		if(av_thread_create(&file->prefetch_thread, av_prefetch_proc, file)) {
+			file->flags |= AV_FILE_PREFETCHING;
+		}
+	}
+}
+
+static void av_pause_prefetch(av_file *file) {
+	// let the demux thread finish the packet it's reading, keeping what was read ahead,
+	// so AVStream fields and the index can be touched safely until it's started again
+	if(file->flags & AV_FILE_PREFETCHING) {
+		av_mutex_lock(&file->prefetch_mutex);
+		file->prefetch_pause = TRUE;
+		av_cond_signal(&file->prefetch_not_full);
+		av_mutex_unlock(&file->prefetch_mutex);
+		av_thread_join(file->prefetch_thread);
+		file->flags &= ~AV_FILE_PREFETCHING;
+		file->prefetch_pause = FALSE;
+	}
+}
+
+static void av_stop_prefetch(av_file *file) {
+	if(file->flags & AV_FILE_PREFETCHING) {
+		av_mutex_lock(&file->prefetch_mutex);
+		file->prefetch_stop = TRUE;
+		av_cond_signal(&file->prefetch_not_full);
+		av_mutex_unlock(&file->prefetch_mutex);
+		av_thread_join(file->prefetch_thread);
+		file->flags &= ~AV_FILE_PREFETCHING;
+		file->prefetch_stop = FALSE;
+	}
+
+	// throw away packets that were read ahead
+	while(file->prefetch_count > 0) {
+		av_free_packet(&file->prefetch_queue[file->prefetch_queue_head]);
+		file->prefetch_queue_head = (file->prefetch_queue_head + 1) & (file->prefetch_queue_size - 1);
+		file->prefetch_count--;
+	}
+	file->prefetch_queue_head = 0;
+	file->prefetch_bytes = 0;
+}
+
+static int av_read_file_packet(av_file *file, AVPacket *packet) {
+	if(file->prefetch_queue) {
+		int result = 0;
+		av_start_prefetch(file);
+		av_mutex_lock(&file->prefetch_mutex);
+		while(file->prefetch_count == 0 && !file->prefetch_eof && (file->flags & AV_FILE_PREFETCHING)) {
+			av_cond_wait(&file->prefetch_not_empty, &file->prefetch_mutex);
+		}
+		if(file->prefetch_count > 0) {
+			// take ownership of the packet
+			*packet = file->prefetch_queue[file->prefetch_queue_head];
+			file->prefetch_queue_head = (file->prefetch_queue_head + 1) & (file->prefetch_queue_size - 1);
+			file->prefetch_count--;
+			file->prefetch_bytes -= packet->size;
+			av_cond_signal(&file->prefetch_not_full);
+		} else if(file->flags & AV_FILE_PREFETCHING) {
+			result = -1;
+		} else {
+			// the thread couldn't be started
+			result = 1;
+		}
+		av_mutex_unlock(&file->prefetch_mutex);
+		if(result <= 0) {
+			return result;
+		}
+	}
+	return av_read_frame(file->format_cxt, packet);
+}
+
 static void av_set_log_level(TSRMLS_D) {
 	if(AV_G(verbose_reporting)) {
 		av_log_set_level(AV_LOG_VERBOSE);
@@ -399,6 +710,8 @@ PHP_MINIT_FUNCTION(av)
 	REGISTER_INI_ENTRIES();
 
 	av_set_log_level(TSRMLS_C);
+	av_init_simd(AV_G(simd));
+	av_init_scaler_cache((AV_G(scaler_cache_size) > 0) ? AV_G(scaler_cache_size) : 0);
 	av_register_all();
 	avcodec_register_all();
 	le_av_file = zend_register_list_destructors_ex(php_free_av_file, NULL, "av file", module_number);
@@ -412,6 +725,7 @@ PHP_MINIT_FUNCTION(av)
  */
 PHP_MSHUTDOWN_FUNCTION(av)
 {
+	av_free_scaler_cache();
 	UNREGISTER_INI_ENTRIES();
 	return SUCCESS;
 }
@@ -487,8 +801,11 @@ PHP_MINFO_FUNCTION(av)
 	php_info_print_table_start();
 	php_info_print_table_header(2, "av support", "enabled");
 	php_info_print_table_row(2, "Version", STRING(AV_MAJOR_VERSION) "." STRING(AV_MINOR_VERSION));
+	php_info_print_table_row(2, "Pixel conversion SIMD", av_get_simd_name());
 	php_info_print_table_end();
 
+	av_print_scaler_cache_info();
+
 	DISPLAY_INI_ENTRIES();
 
 	php_info_print_table_start();
@@ -552,6 +869,9 @@ PHP_FUNCTION(av_file_open)
 	AVOutputFormat *output_format = NULL;
 	AVFormatContext *format_cxt = NULL;
 	char *new_filename = NULL;
+	long discard_threshold = 0;
+	long prefetch = 0, prefetch_bytes = 0;
+	uint32_t i;
 
 	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|a", &filename, &filename_len, &mode, &mode_len, &z_options) == FAILURE) {
 		return;
@@ -584,6 +904,14 @@ PHP_FUNCTION(av_file_open)
 			return;
 		}
 		input_format = format_cxt->iformat;
+
+		// skip streams that aren't opened through av_stream_open()
+		for(i = 0; i < format_cxt->nb_streams; i++) {
+			format_cxt->streams[i]->discard = AVDISCARD_ALL;
+		}
+		av_get_element_long(z_options, "discard_threshold", &discard_threshold);
+		av_get_element_long(z_options, "prefetch", &prefetch);
+		av_get_element_long(z_options, "prefetch_bytes", &prefetch_bytes);
 	} else if(flags & AV_FILE_WRITE) {
 		AVIOContext *pb = NULL;
 		if(z_options) {
@@ -639,6 +967,27 @@ PHP_FUNCTION(av_file_open)
 	file->input_format = input_format;
 	file->output_format = output_format;
 	file->flags = flags;
+	file->discard_threshold = (discard_threshold > 0) ? (uint32_t) discard_threshold : 0;
+
+	if(prefetch > 0 || prefetch_bytes > 0) {
+		// round the ring buffer size up to a power of two
+		uint32_t queue_size = 1;
+		while(queue_size < (uint32_t) prefetch && queue_size < 0x10000) {
+			queue_size <<= 1;
+		}
+		if(prefetch <= 0) {
+			// limited by bytes only
+			queue_size = AV_PREFETCH_DEFAULT_SIZE;
+		}
+		file->prefetch_queue = ecalloc(queue_size, sizeof(AVPacket));
+		file->prefetch_queue_size = queue_size;
+		file->prefetch_byte_limit = (prefetch_bytes > 0) ? (uint32_t) prefetch_bytes : 0;
+		av_mutex_init(&file->prefetch_mutex);
+		av_cond_init(&file->prefetch_not_empty);
+		av_cond_init(&file->prefetch_not_full);
+		format_cxt->interrupt_callback.callback = av_prefetch_interrupt;
+		format_cxt->interrupt_callback.opaque = file;
+	}
 
 	if(format_cxt->nb_streams) {
 		file->streams = emalloc(sizeof(av_stream) * format_cxt->nb_streams);
@@ -673,12 +1022,29 @@ PHP_FUNCTION(av_file_close)
 }
 /* }}} */
 
+static av_stream *av_find_open_video_stream(av_file *file) {
+	uint32_t i;
+	for(i = 0; i < file->stream_count; i++) {
+		av_stream *strm = file->streams[i];
+		if(strm && !(strm->flags & AV_STREAM_FREED)) {
+			if(strm->codec->type == AVMEDIA_TYPE_VIDEO) {
+				return strm;
+			}
+		}
+	}
+	return NULL;
+}
+
 static int av_seek_file(av_file *file, double time, int precise) {
 	double time_unit;
 	int64_t min_time_stamp, time_stamp, max_time_stamp;
 	int32_t stream_index = -1;
+	av_stream *video_strm;
 	uint32_t i;
 
+	// the demux thread cannot be reading while the file position changes
+	av_stop_prefetch(file);
+
 	// get rid of packets that were placed in each stream's queue
 	for(i = 0; i < file->stream_count; i++) {
 		av_stream *strm = file->streams[i];
@@ -686,6 +1052,9 @@ static int av_seek_file(av_file *file, double time, int precise) {
 			while(strm->packet) {
 				av_shift_packet(strm);
 			}
+			if((strm->flags & AV_STREAM_DISCARDING) && !(strm->flags & AV_STREAM_FREED)) {
+				av_set_stream_discard(strm, FALSE);
+			}
 			if(strm->next_frame) {
 				// remove the next frame as well(retrieved by a previous precise seek) 
 				avcodec_free_frame(&strm->next_frame);
@@ -696,14 +1065,9 @@ static int av_seek_file(av_file *file, double time, int precise) {
 	}
 
 	// use the video stream if there's one opened
-	for(i = 0; i < file->stream_count; i++) {
-		av_stream *strm = file->streams[i];
-		if(strm && !(strm->flags & AV_STREAM_FREED)) {
-			if(strm->codec->type == AVMEDIA_TYPE_VIDEO) {
-				stream_index = i;
-				break;
-			}
-		}
+	video_strm = av_find_open_video_stream(file);
+	if(video_strm) {
+		stream_index = video_strm->index;
 	}
 
 	// use the first opened stream
@@ -859,6 +1223,8 @@ PHP_FUNCTION(av_file_stat)
 	av_set_element_string(return_value, "format_name", format_name);
 	av_set_element_long(return_value, "bit_rate", f->bit_rate);
 	av_set_element_double(return_value, "duration", overall_duration);
+	av_set_element_long(return_value, "packet_pool_hits", file->packet_pool_hits);
+	av_set_element_long(return_value, "packet_pool_misses", file->packet_pool_misses);
 
 	// add metadata of file
 	MAKE_STD_ZVAL(metadata);
@@ -937,6 +1303,14 @@ PHP_FUNCTION(av_file_stat)
 				break;
 		}
 
+		// report the state of the packet queue if the stream is open
+		if(i < file->stream_count && file->streams[i]) {
+			av_stream *strm = file->streams[i];
+			av_set_element_long(stream, "packet_queue_length", strm->packet_count);
+			av_set_element_long(stream, "packet_queue_peak", strm->packet_count_max);
+			av_set_element_long(stream, "packet_queue_size", strm->packet_queue_size);
+		}
+
 		// add metadata of stream
 		MAKE_STD_ZVAL(metadata);
 		array_init(metadata);
@@ -1085,6 +1459,17 @@ PHP_FUNCTION(av_stream_open)
 	int32_t stream_index;
 	double frame_duration = 0;
 	long thread_count = 0;
+	int32_t stream_flags = 0;
+	int scaler_flags = SWS_FAST_BILINEAR;
+	long scaling_threads = 1;
+	char *shared_memory_name = NULL;
+	long shared_memory_slot_count = AV_SHARED_FRAME_DEFAULT_SLOTS;
+	long shared_memory_slot_size = 0;
+	enum AVSampleFormat pcm_sample_fmt = AV_SAMPLE_FMT_FLT;
+	long pcm_sample_rate = AV_PCM_DEFAULT_SAMPLE_RATE;
+	long pcm_channels = 2;
+	long pcm_channel_layout = AV_CH_LAYOUT_STEREO;
+	long trusted_input = FALSE;
 	enum AVMediaType media_type;
 
 	if(zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz|a", &z_strm, &z_id, &z_options) == FAILURE) {
@@ -1096,6 +1481,8 @@ PHP_FUNCTION(av_stream_open)
 
 	// figure out the stream index first
 	if(file->flags & AV_FILE_READ) {
+		// the demux thread might be reading the streams
+		av_pause_prefetch(file);
 		if(Z_TYPE_P(z_id) == IS_STRING) {
 			media_type = av_get_stream_type(Z_STRVAL_P(z_id) TSRMLS_CC);
 			if(media_type < 0) {
@@ -1128,6 +1515,7 @@ PHP_FUNCTION(av_stream_open)
 				if(strm->flags & AV_STREAM_FREED) {
 					// return it again
 					strm->flags &= ~AV_STREAM_FREED;
+					av_set_stream_discard(strm, FALSE);
 					file->open_stream_count++;
 					ZEND_REGISTER_RESOURCE(return_value, strm, le_av_strm);
 				} else {
@@ -1154,6 +1542,72 @@ PHP_FUNCTION(av_stream_open)
 		stream_index = file->stream_count;
 	}
 
+	// choose the scaling algorithm used for conversion to and from RGBA
+	if(media_type == AVMEDIA_TYPE_VIDEO) {
+		char *scaling = NULL;
+		long accurate_rounding = FALSE, full_chroma = FALSE, bit_exact = FALSE;
+		if(av_get_element_string(z_options, "scaling", &scaling)) {
+			scaler_flags = av_get_scaling_flags(scaling TSRMLS_CC);
+			if(scaler_flags < 0) {
+				return;
+			}
+		}
+		if(av_get_element_long(z_options, "accurate_rounding", &accurate_rounding) && accurate_rounding) {
+			scaler_flags |= SWS_ACCURATE_RND;
+		}
+		if(av_get_element_long(z_options, "full_chroma", &full_chroma) && full_chroma) {
+			scaler_flags |= SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP;
+		}
+		if(av_get_element_long(z_options, "bit_exact", &bit_exact) && bit_exact) {
+			scaler_flags |= SWS_BITEXACT;
+		}
+		// split scaling of large frames into slices handled by separate threads
+		if(av_get_element_long(z_options, "scaling_threads", &scaling_threads)) {
+			if(AV_G(max_threads_per_stream) != 0 && scaling_threads > AV_G(max_threads_per_stream)) {
+				scaling_threads = AV_G(max_threads_per_stream);
+			}
+			if(scaling_threads < 1) {
+				scaling_threads = 1;
+			}
+		}
+	}
+
+	// choose the format of PCM data exchanged with PHP
+	if(media_type == AVMEDIA_TYPE_AUDIO) {
+		char *pcm_format = NULL;
+		if(av_get_element_string(z_options, "pcm_format", &pcm_format)) {
+			if(strcmp(pcm_format, "native") == 0) {
+				pcm_sample_fmt = AV_SAMPLE_FMT_NONE;
+			} else {
+				pcm_sample_fmt = av_get_sample_fmt(pcm_format);
+				if(pcm_sample_fmt == AV_SAMPLE_FMT_NONE) {
+					php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid sample format '%s'", pcm_format);
+					return;
+				}
+#if !defined(HAVE_SWRESAMPLE) && !defined(HAVE_AVRESAMPLE)
+				if(av_sample_fmt_is_planar(pcm_sample_fmt)) {
+					php_error_docref(NULL TSRMLS_CC, E_WARNING, "Planar sample formats require libswresample or libavresample");
+					return;
+				}
+#endif
+			}
+		}
+		av_get_element_long(z_options, "pcm_sample_rate", &pcm_sample_rate);
+		if(av_get_element_long(z_options, "trusted_input", &trusted_input) && trusted_input) {
+			// caller guarantees the samples are in range--skip clamping
+			stream_flags |= AV_STREAM_TRUSTED_INPUT;
+		}
+		if(av_get_element_long(z_options, "pcm_channel_layout", &pcm_channel_layout)) {
+			pcm_channels = av_get_channel_layout_nb_channels(pcm_channel_layout);
+		} else if(av_get_element_long(z_options, "pcm_channels", &pcm_channels)) {
+			pcm_channel_layout = (pcm_channels > 0) ? av_get_default_channel_layout(pcm_channels) : 0;
+		}
+		if(pcm_sample_rate < 0 || pcm_channels < 0 || pcm_channels > AV_PCM_MAX_CHANNELS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid PCM sample rate or channel count");
+			return;
+		}
+	}
+
 	// set the thread count
 	if(AV_G(max_threads_per_stream) != 0) {
 		switch(media_type) {
@@ -1178,9 +1632,49 @@ PHP_FUNCTION(av_stream_open)
 	}
 
 	if(file->flags & AV_FILE_READ) {
+		long keyframes_only = FALSE;
+		long export_motion_vectors = FALSE;
+		long fast_seek = TRUE;
+
+		if(media_type == AVMEDIA_TYPE_VIDEO && av_get_element_string(z_options, "shared_memory", &shared_memory_name)) {
+			av_get_element_long(z_options, "shared_memory_slots", &shared_memory_slot_count);
+			av_get_element_long(z_options, "shared_memory_slot_size", &shared_memory_slot_size);
+			if(shared_memory_slot_count <= 0 || shared_memory_slot_size < 0) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid shared memory slot count or size");
+				return;
+			}
+#ifndef PHP_WIN32
+			// POSIX names are a slash followed by characters other than slashes
+			if(shared_memory_name[0] != '/' || shared_memory_name[1] == '\0' || strchr(shared_memory_name + 1, '/')) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Shared memory name must start with '/' and contain no other '/'");
+				return;
+			}
+#endif
+		}
+
 		stream = file->format_cxt->streams[stream_index];
 		codec_cxt = stream->codec;
 		codec_cxt->thread_count = thread_count;
+		if(media_type == AVMEDIA_TYPE_VIDEO && av_get_element_long(z_options, "keyframes_only", &keyframes_only) && keyframes_only) {
+			// decode key frames only, letting the demuxer skip the rest if it can
+			codec_cxt->skip_frame = AVDISCARD_NONKEY;
+			stream->discard = AVDISCARD_NONKEY;
+			stream_flags |= AV_STREAM_KEYFRAMES_ONLY;
+		} else {
+			stream->discard = AVDISCARD_DEFAULT;
+		}
+		if(media_type == AVMEDIA_TYPE_VIDEO && av_get_element_long(z_options, "fast_seek", &fast_seek) && !fast_seek) {
+			// decode every frame on the way to the time sought
+			stream_flags |= AV_STREAM_FULL_ROLL_FORWARD;
+		}
+		if(media_type == AVMEDIA_TYPE_VIDEO && av_get_element_long(z_options, "export_motion_vectors", &export_motion_vectors) && export_motion_vectors) {
+			// have the decoder attach its motion vectors to each frame as side data
+			if(av_opt_set(codec_cxt, "flags2", "+export_mvs", 0) >= 0) {
+				stream_flags |= AV_STREAM_EXPORTING_MOTION_VECTORS;
+			} else {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Motion vector export is not supported by this version of libavcodec");
+			}
+		}
 		if(avcodec_open2(codec_cxt, codec, NULL) < 0) {
 			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to open codec '%s'", (codec) ? codec->name : "???");
 			return;
@@ -1200,6 +1694,7 @@ PHP_FUNCTION(av_stream_open)
 		long bit_rate = (media_type == AVMEDIA_TYPE_VIDEO) ? 256000 : 64000;
 		long width = 320, height = 240;
 		long gop_size = 600;
+		long b_frames = 0;
 		long channels = 2;
 		long channel_layout = 0;
 		enum AVPixelFormat pix_fmt = AV_PIX_FMT_NONE;
@@ -1249,6 +1744,7 @@ PHP_FUNCTION(av_stream_open)
 				av_get_element_long(z_options, "width", &width);
 				av_get_element_long(z_options, "height", &height);
 				av_get_element_long(z_options, "gop", &gop_size);
+				av_get_element_long(z_options, "b_frames", &b_frames);
 				av_get_element_string(z_options, "pix_fmt", &pixel_format_name);
 				if(pixel_format_name) {
 					pix_fmt = av_get_pix_fmt(pixel_format_name);
@@ -1275,6 +1771,7 @@ PHP_FUNCTION(av_stream_open)
 				codec_cxt->time_base = av_d2q(frame_duration, 1024);
 				codec_cxt->pix_fmt = pix_fmt;
 				codec_cxt->gop_size = gop_size;
+				codec_cxt->max_b_frames = (b_frames > 0) ? b_frames : 0;
 				codec_cxt->bit_rate = bit_rate;
 				break;
 			case AVMEDIA_TYPE_AUDIO:
@@ -1322,17 +1819,38 @@ PHP_FUNCTION(av_stream_open)
 		av_copy_metadata(&stream->metadata, z_options TSRMLS_CC);
 	}
 
+	if(media_type == AVMEDIA_TYPE_AUDIO && pcm_channels == 0 && codec_cxt->channels > AV_PCM_MAX_CHANNELS) {
+		// the codec's channel count will be adopted--planar data needs a plane per channel
+		enum AVSampleFormat sample_fmt = (pcm_sample_fmt != AV_SAMPLE_FMT_NONE) ? pcm_sample_fmt : codec_cxt->sample_fmt;
+		if(av_sample_fmt_is_planar(sample_fmt)) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Planar PCM data is limited to %d channels", AV_PCM_MAX_CHANNELS);
+			avcodec_close(codec_cxt);
+			return;
+		}
+	}
+
 	strm = emalloc(sizeof(av_stream));
 	memset(strm, 0, sizeof(av_stream));
 	strm->stream = stream;
 	strm->codec_cxt = codec_cxt;
 	strm->codec = codec_cxt->codec;
-	strm->packet_queue_size = 32;
-	strm->packet_queue = emalloc(sizeof(AVPacket) * strm->packet_queue_size);
-	memset(strm->packet_queue, 0, sizeof(AVPacket) * strm->packet_queue_size);
+	strm->packet_queue_size = AV_PACKET_QUEUE_INITIAL_SIZE;
+	strm->packet_queue = ecalloc(strm->packet_queue_size, sizeof(AVPacket *));
 	strm->file = file;
 	strm->index = stream_index;
 	strm->frame_duration = frame_duration;
+	strm->flags = stream_flags;
+	strm->scaler_flags = scaler_flags;
+	strm->scaling_threads = scaling_threads;
+	strm->pcm_sample_fmt = pcm_sample_fmt;
+	strm->pcm_sample_rate = pcm_sample_rate;
+	strm->pcm_channels = pcm_channels;
+	strm->pcm_channel_layout = pcm_channel_layout;
+	if(shared_memory_name) {
+		strm->shared_memory_name = estrdup(shared_memory_name);
+		strm->shared_memory_slot_count = shared_memory_slot_count;
+		strm->shared_memory_slot_size = shared_memory_slot_size;
+	}
 	codec_cxt->opaque = strm;
 
 	switch(media_type) {
@@ -1374,12 +1892,15 @@ static int av_read_next_packet(av_stream *strm TSRMLS_DC) {
 	if(!strm->packet) {
 		av_file *file = strm->file;
 		av_stream *dst_strm = NULL;
+		if(strm->flags & AV_STREAM_DISCARDING) {
+			// the stream is being read again
+			av_set_stream_discard(strm, FALSE);
+		}
 		do {
-			AVPacket *packet = emalloc(sizeof(AVPacket));
-			memset(packet, 0, sizeof(AVPacket));
-			if(av_read_frame(file->format_cxt, packet) < 0) {
+			AVPacket *packet = av_acquire_packet(file);
+			if(av_read_file_packet(file, packet) < 0) {
 				file->flags |= AV_FILE_EOF_REACHED;
-				efree(packet);
+				av_release_packet(file, packet);
 				break;
 			}
 			if(packet->stream_index >= 0 && (uint32_t) packet->stream_index < file->stream_count) {
@@ -1388,11 +1909,18 @@ static int av_read_next_packet(av_stream *strm TSRMLS_DC) {
 				php_error_docref(NULL TSRMLS_CC, E_NOTICE, "Invalid stream index: %d", packet->stream_index);
 				dst_strm = NULL;
 			}
-			if(dst_strm) {
+			if(dst_strm && (dst_strm->flags & AV_STREAM_KEYFRAMES_ONLY) && !(packet->flags & AV_PKT_FLAG_KEY)) {
+				// don't bother queuing packets that the decoder would skip
+				dst_strm = NULL;
+			}
+			if(dst_strm && !(dst_strm->flags & AV_STREAM_DISCARDING)) {
 				av_push_packet(dst_strm, packet);
+				if(file->discard_threshold && dst_strm != strm && dst_strm->packet_queue_bytes > file->discard_threshold) {
+					// nobody is reading from the stream--stop queuing its packets
+					av_set_stream_discard(dst_strm, TRUE);
+				}
 			} else {
-				av_free_packet(packet);
-				efree(packet);
+				av_release_packet(file, packet);
 			}
 		} while(dst_strm != strm);
 	}
@@ -1577,10 +2105,7 @@ static void av_flush_remaining_frames(av_stream *strm) {
 
 		if(strm->codec->capabilities & CODEC_CAP_DELAY) {
 			for(;;) {
-				packet = emalloc(sizeof(AVPacket));
-				av_init_packet(packet);
-				packet->data = NULL;
-				packet->size = 0;
+				packet = av_acquire_packet(strm->file);
 
 				switch(strm->codec->type) {
 					case AVMEDIA_TYPE_VIDEO:
@@ -1599,8 +2124,7 @@ static void av_flush_remaining_frames(av_stream *strm) {
 				if(packet_finished) {
 					av_write_next_packet(strm, packet);
 				} else {
-					av_free_packet(packet);
-					efree(packet);
+					av_release_packet(strm->file, packet);
 					break;
 				}
 			}
@@ -1637,7 +2161,160 @@ static int av_flush_pending_packets(av_file *file) {
 #define FOR_ENCODING		0
 #define FOR_DECODING		1
 
-static void av_create_picture_and_scaler(av_stream *strm, uint32_t width, uint32_t height, int purpose) {
+// scalers are kept in a process-wide cache once a stream is done with them, since
+// the same few source and destination geometries tend to recur from request to request
+
+typedef struct av_scaler_cache_entry {
+	av_scaler_key key;
+	struct SwsContext *scaler_cxt;
+	uint64_t last_used;
+} av_scaler_cache_entry;
+
+static av_scaler_cache_entry *av_scaler_cache = NULL;
+static uint32_t av_scaler_cache_size = 0;
+static uint32_t av_scaler_cache_count = 0;
+static uint64_t av_scaler_cache_clock = 0;
+static uint64_t av_scaler_cache_hits = 0;
+static uint64_t av_scaler_cache_misses = 0;
+static uint64_t av_scaler_cache_evictions = 0;
+static av_mutex av_scaler_cache_mutex;
+
+static void av_init_scaler_cache(uint32_t size) {
+	av_mutex_init(&av_scaler_cache_mutex);
+	if(size > 0) {
+		av_scaler_cache = pecalloc(size, sizeof(av_scaler_cache_entry), 1);
+		av_scaler_cache_size = size;
+	}
+}
+
+static void av_free_scaler_cache(void) {
+	uint32_t i;
+	for(i = 0; i < av_scaler_cache_count; i++) {
+		sws_freeContext(av_scaler_cache[i].scaler_cxt);
+	}
+	if(av_scaler_cache) {
+		pefree(av_scaler_cache, 1);
+		av_scaler_cache = NULL;
+	}
+	av_scaler_cache_size = av_scaler_cache_count = 0;
+	av_mutex_destroy(&av_scaler_cache_mutex);
+}
+
+static struct SwsContext *av_acquire_scaler(const av_scaler_key *key) {
+	struct SwsContext *scaler_cxt = NULL;
+	uint32_t i;
+	// a context taken from the cache belongs to the stream until it's released
+	av_mutex_lock(&av_scaler_cache_mutex);
+	for(i = 0; i < av_scaler_cache_count; i++) {
+		if(memcmp(&av_scaler_cache[i].key, key, sizeof(av_scaler_key)) == 0) {
+			scaler_cxt = av_scaler_cache[i].scaler_cxt;
+			av_scaler_cache[i] = av_scaler_cache[--av_scaler_cache_count];
+			break;
+		}
+	}
+	if(scaler_cxt) {
+		av_scaler_cache_hits++;
+	} else {
+		av_scaler_cache_misses++;
+	}
+	av_mutex_unlock(&av_scaler_cache_mutex);
+	if(!scaler_cxt) {
+		scaler_cxt = sws_getContext(key->src_width, key->src_height, key->src_pix_fmt, key->dst_width, key->dst_height, key->dst_pix_fmt, key->flags, NULL, NULL, NULL);
+	}
+	return scaler_cxt;
+}
+
+static void av_release_scaler(struct SwsContext *scaler_cxt, const av_scaler_key *key) {
+	struct SwsContext *evicted_cxt = scaler_cxt;
+	av_mutex_lock(&av_scaler_cache_mutex);
+	if(av_scaler_cache_size > 0) {
+		av_scaler_cache_entry *entry;
+		if(av_scaler_cache_count < av_scaler_cache_size) {
+			entry = &av_scaler_cache[av_scaler_cache_count++];
+			evicted_cxt = NULL;
+		} else {
+			// replace the least recently used context
+			uint32_t i;
+			entry = &av_scaler_cache[0];
+			for(i = 1; i < av_scaler_cache_count; i++) {
+				if(av_scaler_cache[i].last_used < entry->last_used) {
+					entry = &av_scaler_cache[i];
+				}
+			}
+			evicted_cxt = entry->scaler_cxt;
+			av_scaler_cache_evictions++;
+		}
+		entry->key = *key;
+		entry->scaler_cxt = scaler_cxt;
+		entry->last_used = ++av_scaler_cache_clock;
+	}
+	av_mutex_unlock(&av_scaler_cache_mutex);
+	if(evicted_cxt) {
+		sws_freeContext(evicted_cxt);
+	}
+}
+
+static void av_print_scaler_cache_info(void) {
+	char buffer[64];
+	uint64_t hits, misses, evictions, lookups;
+	uint32_t count;
+	av_mutex_lock(&av_scaler_cache_mutex);
+	hits = av_scaler_cache_hits;
+	misses = av_scaler_cache_misses;
+	evictions = av_scaler_cache_evictions;
+	count = av_scaler_cache_count;
+	av_mutex_unlock(&av_scaler_cache_mutex);
+	lookups = hits + misses;
+
+	php_info_print_table_start();
+	php_info_print_table_colspan_header(2, "Scaler cache");
+	snprintf(buffer, sizeof(buffer), "%u / %u", count, av_scaler_cache_size);
+	php_info_print_table_row(2, "Cached contexts", buffer);
+	snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long) hits);
+	php_info_print_table_row(2, "Hits", buffer);
+	snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long) misses);
+	php_info_print_table_row(2, "Misses", buffer);
+	snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long) evictions);
+	php_info_print_table_row(2, "Evictions", buffer);
+	snprintf(buffer, sizeof(buffer), "%.1f%%", (lookups > 0) ? (double) hits * 100 / lookups : 0.0);
+	php_info_print_table_row(2, "Hit rate", buffer);
+	php_info_print_table_end();
+}
+
+static void av_create_scaler(av_stream *strm, uint32_t width, uint32_t height, enum AVPixelFormat pix_fmt, int purpose) {
+	av_scaler_key key;
+	memset(&key, 0, sizeof(key));
+	if(purpose == FOR_ENCODING) {
+		key.src_width = width;
+		key.src_height = height;
+		key.src_pix_fmt = pix_fmt;
+		key.dst_width = strm->codec_cxt->width;
+		key.dst_height = strm->codec_cxt->height;
+		key.dst_pix_fmt = strm->codec_cxt->pix_fmt;
+	} else {
+		key.src_width = strm->codec_cxt->width;
+		key.src_height = strm->codec_cxt->height;
+		key.src_pix_fmt = strm->codec_cxt->pix_fmt;
+		key.dst_width = width;
+		key.dst_height = height;
+		key.dst_pix_fmt = pix_fmt;
+	}
+	key.flags = strm->scaler_flags;
+	if(!strm->scaler_cxt || memcmp(&strm->scaler_key, &key, sizeof(key)) != 0) {
+		if(strm->scaler_cxt) {
+			av_release_scaler(strm->scaler_cxt, &strm->scaler_key);
+		}
+		strm->scaler_cxt = av_acquire_scaler(&key);
+		strm->scaler_key = key;
+		if(!strm->scaler_cxt) {
+			TSRMLS_FETCH();
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to convert from %dx%d %s to %dx%d %s", key.src_width, key.src_height, av_get_pix_fmt_name(key.src_pix_fmt), key.dst_width, key.dst_height, av_get_pix_fmt_name(key.dst_pix_fmt));
+		}
+	}
+}
+
+static void av_create_picture(av_stream *strm, uint32_t width, uint32_t height) {
+	// the buffer also serves for PIX_FMT_RGB32, which has the same layout
 	if(!strm->picture || strm->picture->width != width || strm->picture->height != height) {
 		if(strm->picture) {
 			avpicture_free((AVPicture *) strm->picture);
@@ -1647,112 +2324,386 @@ static void av_create_picture_and_scaler(av_stream *strm, uint32_t width, uint32
 		avpicture_alloc((AVPicture *) strm->picture, PIX_FMT_RGBA, width, height);
 		strm->picture->width = width;
 		strm->picture->height = height;
-		if(purpose == FOR_ENCODING) {
-			strm->scaler_cxt = sws_getCachedContext(strm->scaler_cxt, width, height, PIX_FMT_RGBA, strm->codec_cxt->width, strm->codec_cxt->height, strm->codec_cxt->pix_fmt, SWS_FAST_BILINEAR, NULL, NULL, NULL);
-		} else {
-			strm->scaler_cxt = sws_getCachedContext(strm->scaler_cxt, strm->codec_cxt->width, strm->codec_cxt->height, strm->codec_cxt->pix_fmt, width, height, PIX_FMT_RGBA, SWS_FAST_BILINEAR, NULL, NULL, NULL);
-		}
 	}
 }
 
-#if !defined(HAVE_SWRESAMPLE) && !defined(HAVE_AVRESAMPLE)
-#	define RESAMPLER_REQUIRES_EXTRA_SAMPLES		16
-#endif
+static void av_create_picture_and_scaler(av_stream *strm, uint32_t width, uint32_t height, int purpose) {
+	av_create_picture(strm, width, height);
+	av_create_scaler(strm, width, height, PIX_FMT_RGBA, purpose);
+}
 
-static void av_create_audio_buffer_and_resampler(av_stream *strm, int purpose) {
-	if(!strm->samples) {
-		double frame_duration = (double) strm->codec_cxt->frame_size / strm->codec_cxt->sample_rate;
+#define AV_MIN_SLICE_HEIGHT		64
+#define AV_SLICE_FILTER_RADIUS	4		// source rows a filter reaches on either side, before downscaling widens it
 
-#if defined(HAVE_SWRESAMPLE)
-		if(purpose == FOR_ENCODING) {
-			strm->resampler_cxt = swr_alloc_set_opts(NULL, strm->codec_cxt->channel_layout, strm->codec_cxt->sample_fmt, strm->codec_cxt->sample_rate, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 44100, 0, NULL);
-		} else {
-			strm->resampler_cxt = swr_alloc_set_opts(NULL, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 44100, strm->codec_cxt->channel_layout, strm->codec_cxt->sample_fmt, strm->codec_cxt->sample_rate, 0, NULL);
-		}
-		swr_init(strm->resampler_cxt);
-#elif defined(HAVE_AVRESAMPLE)
-		strm->resampler_cxt = avresample_alloc_context();
-		if(purpose == FOR_ENCODING) {
-			 av_opt_set_int(strm->resampler_cxt, "out_channel_layout", strm->codec_cxt->channel_layout, 0);
-			 av_opt_set_int(strm->resampler_cxt, "out_sample_fmt",     strm->codec_cxt->sample_fmt, 0);
-			 av_opt_set_int(strm->resampler_cxt, "out_sample_rate",    strm->codec_cxt->sample_rate, 0);
-			 av_opt_set_int(strm->resampler_cxt, "in_channel_layout",  AV_CH_LAYOUT_STEREO, 0);
-			 av_opt_set_int(strm->resampler_cxt, "in_sample_fmt",      AV_SAMPLE_FMT_FLT, 0);
-			 av_opt_set_int(strm->resampler_cxt, "in_sample_rate",     44100, 0);
-		} else {
-			 av_opt_set_int(strm->resampler_cxt, "out_channel_layout", AV_CH_LAYOUT_STEREO, 0);
-			 av_opt_set_int(strm->resampler_cxt, "out_sample_fmt",     AV_SAMPLE_FMT_FLT, 0);
-			 av_opt_set_int(strm->resampler_cxt, "out_sample_rate",    44100, 0);
-			 av_opt_set_int(strm->resampler_cxt, "in_channel_layout",  strm->codec_cxt->channel_layout, 0);
-			 av_opt_set_int(strm->resampler_cxt, "in_sample_fmt",      strm->codec_cxt->sample_fmt, 0);
-			 av_opt_set_int(strm->resampler_cxt, "in_sample_rate",     strm->codec_cxt->sample_rate, 0);
-		}
-		avresample_open(strm->resampler_cxt);
-#else
-		enum AVSampleFormat codec_format;
-		int sample_size;
+static int av_get_slice_alignment(const AVPixFmtDescriptor *desc) {
+	// slices can't start in the middle of a subsampled chroma row and palettes can't be offset
+	if(!desc || (desc->flags & (PIX_FMT_PAL | PIX_FMT_PSEUDOPAL | PIX_FMT_BITSTREAM | PIX_FMT_HWACCEL))) {
+		return 0;
+	}
+	return 1 << desc->log2_chroma_h;
+}
 
-		if(strm->codec_cxt->sample_fmt >= AV_SAMPLE_FMT_U8P && strm->codec_cxt->sample_fmt <= AV_SAMPLE_FMT_DBLP) {
-			codec_format = strm->codec_cxt->sample_fmt - AV_SAMPLE_FMT_U8P;
-			strm->deinterleave = TRUE;
-		} else {
-			codec_format = strm->codec_cxt->sample_fmt;
-			strm->deinterleave = FALSE;
-		}
-		switch(codec_format) {
-			case AV_SAMPLE_FMT_U8: sample_size = sizeof(uint8_t) * strm->codec_cxt->channels; break;
-			case AV_SAMPLE_FMT_S16: sample_size = sizeof(int16_t) * strm->codec_cxt->channels; break;
-			case AV_SAMPLE_FMT_S32: sample_size = sizeof(int32_t) * strm->codec_cxt->channels; break;
-			case AV_SAMPLE_FMT_FLT: sample_size = sizeof(float) * strm->codec_cxt->channels; break;
-			case AV_SAMPLE_FMT_DBL: sample_size = sizeof(double) * strm->codec_cxt->channels; break;
-			default: sample_size = 0;
-		}
-		if(purpose == FOR_ENCODING) {
-			strm->resampler_cxt = av_audio_resample_init(strm->codec_cxt->channels, 2, strm->codec_cxt->sample_rate, 44100, codec_format, AV_SAMPLE_FMT_FLT, 16, 10, 0, 0.8);
-			strm->resampler_extra_sample_count = RESAMPLER_REQUIRES_EXTRA_SAMPLES;
-			strm->target_sample_size = sample_size;
-			strm->source_sample_size = sizeof(float) * 2;
-		} else {
-			strm->resampler_cxt = av_audio_resample_init(2, strm->codec_cxt->channels, 44100, strm->codec_cxt->sample_rate, AV_SAMPLE_FMT_FLT, codec_format, 16, 10, 0, 0.8);
-			strm->target_sample_size = sizeof(float) * 2;
-			strm->source_sample_size = sample_size;
-		}
-		if(purpose == FOR_ENCODING || strm->deinterleave) {
-			int resampler_queue_size = av_samples_get_buffer_size(NULL, strm->codec_cxt->channels, strm->codec_cxt->frame_size + RESAMPLER_REQUIRES_EXTRA_SAMPLES, codec_format, 1);
-			strm->resampler_queue = emalloc(resampler_queue_size + FF_INPUT_BUFFER_PADDING_SIZE);
+static void av_release_slices(av_slice_pool *pool) {
+	uint32_t i;
+	for(i = 0; i < pool->slice_count; i++) {
+		av_scaler_slice *slice = &pool->slices[i];
+		if(slice->scaler_cxt) {
+			av_release_scaler(slice->scaler_cxt, &slice->key);
+			slice->scaler_cxt = NULL;
 		}
-#endif
-		if(frame_duration > 0) {
-			if(purpose == FOR_ENCODING) {
-				strm->sample_buffer_size = (uint32_t) floor(frame_duration * 44100);
-			} else {
-				strm->sample_buffer_size = (uint32_t) ceil(frame_duration * 44100);
-			}
-#ifdef RESAMPLER_REQUIRES_EXTRA_SAMPLES
-			strm->samples = emalloc(sizeof(float) * (strm->sample_buffer_size + RESAMPLER_REQUIRES_EXTRA_SAMPLES) * 2 + FF_INPUT_BUFFER_PADDING_SIZE);
-#else
-			strm->samples = emalloc(sizeof(float) * strm->sample_buffer_size * 2 + FF_INPUT_BUFFER_PADDING_SIZE);
-#endif
+		if(slice->buffer[0]) {
+			av_freep(&slice->buffer[0]);
 		}
 	}
+	memset(&pool->key, 0, sizeof(pool->key));
 }
 
-static void av_transfer_picture_to_frame(av_stream *strm) {
-	// allocate the frame buffer if it's not there
-	if(!(strm->flags & AV_STREAM_FRAME_BUFFER_ALLOCATED)) {
-		avpicture_alloc((AVPicture *) strm->frame, strm->codec_cxt->pix_fmt, strm->codec_cxt->width, strm->codec_cxt->height);
-		strm->frame->width = strm->codec_cxt->width;
-		strm->frame->height = strm->codec_cxt->height;
+static int av_create_slices(av_slice_pool *pool, const av_scaler_key *key) {
+	int src_align, dst_align, align, src_unit, dst_unit, unit_count, margin_rows, margin_units, k;
+	int64_t divisor;
+	uint32_t i, n = pool->slice_count;
+
+	if(pool->slices[0].scaler_cxt && memcmp(&pool->key, key, sizeof(av_scaler_key)) == 0) {
+		return TRUE;
+	}
+	av_release_slices(pool);
+	pool->src_desc = av_pix_fmt_desc_get(key->src_pix_fmt);
+	pool->dst_desc = av_pix_fmt_desc_get(key->dst_pix_fmt);
+	src_align = av_get_slice_alignment(pool->src_desc);
+	dst_align = av_get_slice_alignment(pool->dst_desc);
+	if(!src_align || !dst_align || key->src_height < (int) n * AV_MIN_SLICE_HEIGHT || key->dst_height < (int) n * AV_MIN_SLICE_HEIGHT) {
+		return FALSE;
+	}
+	align = (src_align > dst_align) ? src_align : dst_align;
+
+	// cut the frame at multiples of a unit that maps a whole number of source rows onto a whole
+	// number of destination rows, so every slice is scaled at the same ratio and phase as the
+	// whole frame; the destination unit is also kept a multiple of 8 so dithering stays in step
+	divisor = av_gcd(key->src_height, key->dst_height);
+	for(k = 1; k <= 8; k++) {
+		src_unit = (int) (key->src_height / divisor) * k;
+		dst_unit = (int) (key->dst_height / divisor) * k;
+		if(!(src_unit % align) && !(dst_unit % align) && !(dst_unit & 7)) {
+			break;
+		}
+	}
+	unit_count = key->dst_height / dst_unit;
+	if(k > 8 || unit_count < (int) n) {
+		return FALSE;
+	}
+
+	// each slice also scales enough rows beyond its edges for the filters to see the same
+	// neighbours they would in the whole frame; the extra output is thrown away
+	margin_rows = AV_SLICE_FILTER_RADIUS * ((src_unit + dst_unit - 1) / dst_unit) * align;
+	margin_units = (margin_rows + src_unit - 1) / src_unit;
+	av_image_fill_linesizes(pool->dst_bytewidth, key->dst_pix_fmt, key->dst_width);
+	for(i = 0; i < n; i++) {
+		av_scaler_slice *slice = &pool->slices[i];
+		int first = (int) ((int64_t) unit_count * i / n);
+		int last = (int) ((int64_t) unit_count * (i + 1) / n);
+		int window_first = (first > margin_units) ? first - margin_units : 0;
+		int window_last = (last + margin_units < unit_count) ? last + margin_units : unit_count;
+		slice->src_y = window_first * src_unit;
+		slice->dst_y = first * dst_unit;
+		slice->dst_rows = (last - first) * dst_unit;
+		slice->margin = (first - window_first) * dst_unit;
+		slice->key = *key;
+		slice->key.src_height = (window_last - window_first) * src_unit;
+		slice->key.dst_height = (window_last - window_first) * dst_unit;
+		slice->scaler_cxt = av_acquire_scaler(&slice->key);
+		if(!slice->scaler_cxt || av_image_alloc(slice->buffer, slice->buffer_stride, key->dst_width, slice->key.dst_height, key->dst_pix_fmt, 16) < 0) {
+			av_release_slices(pool);
+			return FALSE;
+		}
+	}
+	pool->key = *key;
+	return TRUE;
+}
+
+static void av_scale_slice(av_slice_pool *pool, uint32_t index) {
+	av_scaler_slice *slice = &pool->slices[index];
+	const uint8_t *src[4] = { NULL, NULL, NULL, NULL };
+	int i;
+	for(i = 0; i < 4; i++) {
+		// the chroma planes are subsampled vertically; the alpha plane isn't
+		int src_y = (i == 1 || i == 2) ? slice->src_y >> pool->src_desc->log2_chroma_h : slice->src_y;
+		if(pool->src[i]) {
+			src[i] = pool->src[i] + (ptrdiff_t) pool->src_stride[i] * src_y;
+		}
+	}
+	sws_scale(slice->scaler_cxt, src, pool->src_stride, 0, slice->key.src_height, slice->buffer, slice->buffer_stride);
+
+	// copy the rows the slice is responsible for
+	for(i = 0; i < 4 && pool->dst[i]; i++) {
+		int shift = (i == 1 || i == 2) ? pool->dst_desc->log2_chroma_h : 0;
+		uint8_t *dst = pool->dst[i] + (ptrdiff_t) pool->dst_stride[i] * (slice->dst_y >> shift);
+		const uint8_t *buffer = slice->buffer[i] + (ptrdiff_t) slice->buffer_stride[i] * (slice->margin >> shift);
+		av_image_copy_plane(dst, pool->dst_stride[i], buffer, slice->buffer_stride[i], pool->dst_bytewidth[i], slice->dst_rows >> shift);
+	}
+}
+
+static AV_THREAD_PROC(av_slice_proc, arg) {
+	av_slice_worker *worker = arg;
+	av_slice_pool *pool = worker->pool;
+	uint32_t generation = 0;
+
+	for(;;) {
+		av_mutex_lock(&pool->mutex);
+		while(!pool->stop && pool->generation == generation) {
+			av_cond_wait(&pool->start, &pool->mutex);
+		}
+		if(pool->stop) {
+			av_mutex_unlock(&pool->mutex);
+			break;
+		}
+		generation = pool->generation;
+		av_mutex_unlock(&pool->mutex);
+
+		av_scale_slice(pool, worker->index);
+
+		av_mutex_lock(&pool->mutex);
+		if(--pool->remaining == 0) {
+			av_cond_signal(&pool->done);
+		}
+		av_mutex_unlock(&pool->mutex);
+	}
+	AV_THREAD_RETURN;
+}
+
+static av_slice_pool *av_create_slice_pool(uint32_t slice_count) {
+	av_slice_pool *pool = emalloc(sizeof(av_slice_pool));
+	uint32_t i;
+	memset(pool, 0, sizeof(av_slice_pool));
+	pool->slice_count = slice_count;
+	pool->slices = ecalloc(slice_count, sizeof(av_scaler_slice));
+	pool->workers = ecalloc(slice_count - 1, sizeof(av_slice_worker));
+	av_mutex_init(&pool->mutex);
+	av_cond_init(&pool->start);
+	av_cond_init(&pool->done);
+	for(i = 0; i < slice_count - 1; i++) {
+		av_slice_worker *worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i + 1;
+		if(!av_thread_create(&worker->thread, av_slice_proc, worker)) {
+			break;
+		}
+		pool->worker_count++;
+	}
+	if(pool->worker_count < slice_count - 1) {
+		// couldn't start all the threads--don't use the pool
+		av_free_slice_pool(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+static void av_free_slice_pool(av_slice_pool *pool) {
+	uint32_t i;
+	av_mutex_lock(&pool->mutex);
+	pool->stop = TRUE;
+	av_cond_broadcast(&pool->start);
+	av_mutex_unlock(&pool->mutex);
+	for(i = 0; i < pool->worker_count; i++) {
+		av_thread_join(pool->workers[i].thread);
+	}
+	av_release_slices(pool);
+	av_cond_destroy(&pool->done);
+	av_cond_destroy(&pool->start);
+	av_mutex_destroy(&pool->mutex);
+	efree(pool->workers);
+	efree(pool->slices);
+	efree(pool);
+}
+
+static int av_scale_in_slices(av_stream *strm, const uint8_t * const *src, const int *src_stride, uint8_t * const *dst, const int *dst_stride) {
+	av_slice_pool *pool;
+	int i;
+
+	if(!strm->slice_pool) {
+		strm->slice_pool = av_create_slice_pool(strm->scaling_threads);
+		if(!strm->slice_pool) {
+			strm->scaling_threads = 1;
+			return FALSE;
+		}
+	}
+	pool = strm->slice_pool;
+	if(!av_create_slices(pool, &strm->scaler_key)) {
+		return FALSE;
+	}
+	for(i = 0; i < 4; i++) {
+		pool->src[i] = src[i];
+		pool->src_stride[i] = src_stride[i];
+		pool->dst[i] = dst[i];
+		pool->dst_stride[i] = dst_stride[i];
+	}
+
+	// wake the workers, do the first slice here, then wait for the rest
+	av_mutex_lock(&pool->mutex);
+	pool->remaining = pool->worker_count;
+	pool->generation++;
+	av_cond_broadcast(&pool->start);
+	av_mutex_unlock(&pool->mutex);
+
+	av_scale_slice(pool, 0);
+
+	av_mutex_lock(&pool->mutex);
+	while(pool->remaining > 0) {
+		av_cond_wait(&pool->done, &pool->mutex);
+	}
+	av_mutex_unlock(&pool->mutex);
+	return TRUE;
+}
+
+static void av_scale_picture(av_stream *strm, const uint8_t * const *src, const int *src_stride, uint8_t * const *dst, const int *dst_stride) {
+	if(!strm->scaler_cxt) {
+		// av_create_scaler() has already complained
+		return;
+	}
+	if(strm->scaling_threads > 1 && av_scale_in_slices(strm, src, src_stride, dst, dst_stride)) {
+		return;
+	}
+	sws_scale(strm->scaler_cxt, src, src_stride, 0, strm->scaler_key.src_height, dst, dst_stride);
+}
+
+#if !defined(HAVE_SWRESAMPLE) && !defined(HAVE_AVRESAMPLE)
+#	define RESAMPLER_REQUIRES_EXTRA_SAMPLES		16
+#endif
+
+static void av_get_pcm_planes(av_stream *strm, uint8_t **planes) {
+	// planes are laid out back to back, each large enough for a full frame
+	int i, plane_count = av_sample_fmt_is_planar(strm->pcm_sample_fmt) ? strm->pcm_channels : 1;
+	for(i = 0; i < plane_count; i++) {
+		planes[i] = strm->samples + strm->sample_buffer_size * strm->pcm_sample_size * i;
+	}
+}
+
+static void av_create_audio_buffer_and_resampler(av_stream *strm, int purpose) {
+	if(!strm->samples) {
+		double frame_duration = (double) strm->codec_cxt->frame_size / strm->codec_cxt->sample_rate;
+		int64_t codec_channel_layout = (strm->codec_cxt->channel_layout) ? strm->codec_cxt->channel_layout : av_get_default_channel_layout(strm->codec_cxt->channels);
+
+		// fill in the settings that follow the codec
+		if(strm->pcm_sample_fmt == AV_SAMPLE_FMT_NONE) {
+#if defined(HAVE_SWRESAMPLE) || defined(HAVE_AVRESAMPLE)
+			strm->pcm_sample_fmt = strm->codec_cxt->sample_fmt;
+#else
+			strm->pcm_sample_fmt = av_get_packed_sample_fmt(strm->codec_cxt->sample_fmt);
+#endif
+		}
+		if(strm->pcm_sample_rate == 0) {
+			strm->pcm_sample_rate = strm->codec_cxt->sample_rate;
+		}
+		if(strm->pcm_channels == 0) {
+			strm->pcm_channels = strm->codec_cxt->channels;
+			strm->pcm_channel_layout = codec_channel_layout;
+			if(strm->pcm_channels > AV_PCM_MAX_CHANNELS) {
+				// too many channels to give each one a plane
+				strm->pcm_sample_fmt = av_get_packed_sample_fmt(strm->pcm_sample_fmt);
+			}
+		}
+		strm->pcm_sample_size = av_get_bytes_per_sample(strm->pcm_sample_fmt);
+		strm->pcm_passthrough = (strm->pcm_sample_fmt == strm->codec_cxt->sample_fmt && strm->pcm_sample_rate == strm->codec_cxt->sample_rate
+							  && strm->pcm_channels == strm->codec_cxt->channels && strm->pcm_channel_layout == codec_channel_layout);
+
+		if(!strm->pcm_passthrough) {
+#if defined(HAVE_SWRESAMPLE)
+			if(purpose == FOR_ENCODING) {
+				strm->resampler_cxt = swr_alloc_set_opts(NULL, codec_channel_layout, strm->codec_cxt->sample_fmt, strm->codec_cxt->sample_rate, strm->pcm_channel_layout, strm->pcm_sample_fmt, strm->pcm_sample_rate, 0, NULL);
+			} else {
+				strm->resampler_cxt = swr_alloc_set_opts(NULL, strm->pcm_channel_layout, strm->pcm_sample_fmt, strm->pcm_sample_rate, codec_channel_layout, strm->codec_cxt->sample_fmt, strm->codec_cxt->sample_rate, 0, NULL);
+			}
+			swr_init(strm->resampler_cxt);
+#elif defined(HAVE_AVRESAMPLE)
+			strm->resampler_cxt = avresample_alloc_context();
+			if(purpose == FOR_ENCODING) {
+				 av_opt_set_int(strm->resampler_cxt, "out_channel_layout", codec_channel_layout, 0);
+				 av_opt_set_int(strm->resampler_cxt, "out_sample_fmt",     strm->codec_cxt->sample_fmt, 0);
+				 av_opt_set_int(strm->resampler_cxt, "out_sample_rate",    strm->codec_cxt->sample_rate, 0);
+				 av_opt_set_int(strm->resampler_cxt, "in_channel_layout",  strm->pcm_channel_layout, 0);
+				 av_opt_set_int(strm->resampler_cxt, "in_sample_fmt",      strm->pcm_sample_fmt, 0);
+				 av_opt_set_int(strm->resampler_cxt, "in_sample_rate",     strm->pcm_sample_rate, 0);
+			} else {
+				 av_opt_set_int(strm->resampler_cxt, "out_channel_layout", strm->pcm_channel_layout, 0);
+				 av_opt_set_int(strm->resampler_cxt, "out_sample_fmt",     strm->pcm_sample_fmt, 0);
+				 av_opt_set_int(strm->resampler_cxt, "out_sample_rate",    strm->pcm_sample_rate, 0);
+				 av_opt_set_int(strm->resampler_cxt, "in_channel_layout",  codec_channel_layout, 0);
+				 av_opt_set_int(strm->resampler_cxt, "in_sample_fmt",      strm->codec_cxt->sample_fmt, 0);
+				 av_opt_set_int(strm->resampler_cxt, "in_sample_rate",     strm->codec_cxt->sample_rate, 0);
+			}
+			avresample_open(strm->resampler_cxt);
+#else
+			enum AVSampleFormat codec_format;
+			int sample_size;
+
+			if(strm->codec_cxt->sample_fmt >= AV_SAMPLE_FMT_U8P && strm->codec_cxt->sample_fmt <= AV_SAMPLE_FMT_DBLP) {
+				codec_format = strm->codec_cxt->sample_fmt - AV_SAMPLE_FMT_U8P;
+				strm->deinterleave = TRUE;
+			} else {
+				codec_format = strm->codec_cxt->sample_fmt;
+				strm->deinterleave = FALSE;
+			}
+			switch(codec_format) {
+				case AV_SAMPLE_FMT_U8: sample_size = sizeof(uint8_t) * strm->codec_cxt->channels; break;
+				case AV_SAMPLE_FMT_S16: sample_size = sizeof(int16_t) * strm->codec_cxt->channels; break;
+				case AV_SAMPLE_FMT_S32: sample_size = sizeof(int32_t) * strm->codec_cxt->channels; break;
+				case AV_SAMPLE_FMT_FLT: sample_size = sizeof(float) * strm->codec_cxt->channels; break;
+				case AV_SAMPLE_FMT_DBL: sample_size = sizeof(double) * strm->codec_cxt->channels; break;
+				default: sample_size = 0;
+			}
+			if(purpose == FOR_ENCODING) {
+				strm->resampler_cxt = av_audio_resample_init(strm->codec_cxt->channels, strm->pcm_channels, strm->codec_cxt->sample_rate, strm->pcm_sample_rate, codec_format, strm->pcm_sample_fmt, 16, 10, 0, 0.8);
+				strm->resampler_extra_sample_count = RESAMPLER_REQUIRES_EXTRA_SAMPLES;
+				strm->target_sample_size = sample_size;
+				strm->source_sample_size = strm->pcm_sample_size * strm->pcm_channels;
+			} else {
+				strm->resampler_cxt = av_audio_resample_init(strm->pcm_channels, strm->codec_cxt->channels, strm->pcm_sample_rate, strm->codec_cxt->sample_rate, strm->pcm_sample_fmt, codec_format, 16, 10, 0, 0.8);
+				strm->target_sample_size = strm->pcm_sample_size * strm->pcm_channels;
+				strm->source_sample_size = sample_size;
+			}
+			if(purpose == FOR_ENCODING || strm->deinterleave) {
+				int resampler_queue_size = av_samples_get_buffer_size(NULL, strm->codec_cxt->channels, strm->codec_cxt->frame_size + RESAMPLER_REQUIRES_EXTRA_SAMPLES, codec_format, 1);
+				strm->resampler_queue = emalloc(resampler_queue_size + FF_INPUT_BUFFER_PADDING_SIZE);
+			}
+#endif
+		}
+		if(frame_duration > 0) {
+			uint32_t sample_frame_size = strm->pcm_sample_size * strm->pcm_channels;
+			if(strm->pcm_passthrough) {
+				strm->sample_buffer_size = strm->codec_cxt->frame_size;
+			} else if(purpose == FOR_ENCODING) {
+				strm->sample_buffer_size = (uint32_t) floor(frame_duration * strm->pcm_sample_rate);
+			} else {
+				strm->sample_buffer_size = (uint32_t) ceil(frame_duration * strm->pcm_sample_rate);
+			}
+#ifdef RESAMPLER_REQUIRES_EXTRA_SAMPLES
+			strm->samples = emalloc(sample_frame_size * (strm->sample_buffer_size + RESAMPLER_REQUIRES_EXTRA_SAMPLES) + FF_INPUT_BUFFER_PADDING_SIZE);
+#else
+			strm->samples = emalloc(sample_frame_size * strm->sample_buffer_size + FF_INPUT_BUFFER_PADDING_SIZE);
+#endif
+		}
+	}
+}
+
+static void av_allocate_frame_buffer(av_stream *strm) {
+	// allocate the frame buffer if it's not there
+	if(!(strm->flags & AV_STREAM_FRAME_BUFFER_ALLOCATED)) {
+		avpicture_alloc((AVPicture *) strm->frame, strm->codec_cxt->pix_fmt, strm->codec_cxt->width, strm->codec_cxt->height);
+		strm->frame->width = strm->codec_cxt->width;
+		strm->frame->height = strm->codec_cxt->height;
 		strm->frame->format = strm->codec_cxt->pix_fmt;
 		strm->flags |= AV_STREAM_FRAME_BUFFER_ALLOCATED;
 	}
+}
+
+static void av_transfer_picture_to_frame(av_stream *strm) {
+	av_allocate_frame_buffer(strm);
 	// rescale the picture to the proper dimension and transform pixels to format used by codec
-	sws_scale(strm->scaler_cxt, (const uint8_t * const *) strm->picture->data, strm->picture->linesize, 0, strm->picture->height, strm->frame->data, strm->frame->linesize);
+	av_scale_picture(strm, (const uint8_t * const *) strm->picture->data, strm->picture->linesize, strm->frame->data, strm->frame->linesize);
 }
 
 static void av_transfer_picture_from_frame(av_stream *strm) {
 	// rescale the picture and transform pixels to RGBA
-	sws_scale(strm->scaler_cxt, (const uint8_t * const *) strm->frame->data, strm->frame->linesize, 0, strm->frame->height, strm->picture->data, strm->picture->linesize);
+	av_scale_picture(strm, (const uint8_t * const *) strm->frame->data, strm->frame->linesize, strm->picture->data, strm->picture->linesize);
 }
 
 #ifndef HAVE_AVCODEC_FILL_AUDIO_FRAME
@@ -1804,10 +2755,25 @@ static void av_transfer_pcm_to_frame(av_stream *strm) {
 		avcodec_fill_audio_frame(strm->frame, strm->codec_cxt->channels, strm->codec_cxt->sample_fmt, buffer, buffer_size, 1);
 		strm->flags |= AV_STREAM_AUDIO_BUFFER_ALLOCATED;
 	}
+	if(strm->pcm_passthrough) {
+		uint8_t *planes[AV_PCM_MAX_CHANNELS];
+		av_get_pcm_planes(strm, planes);
+		strm->frame->nb_samples = strm->sample_count;
+		av_samples_copy(strm->frame->extended_data, planes, 0, 0, strm->sample_count, strm->pcm_channels, strm->pcm_sample_fmt);
+		return;
+	}
 #if defined(HAVE_SWRESAMPLE)
-	strm->frame->nb_samples = swr_convert(strm->resampler_cxt, (uint8_t **) strm->frame->data, strm->frame->nb_samples, (const uint8_t **) &strm->samples, strm->sample_count);
+	{
+		uint8_t *planes[AV_PCM_MAX_CHANNELS];
+		av_get_pcm_planes(strm, planes);
+		strm->frame->nb_samples = swr_convert(strm->resampler_cxt, (uint8_t **) strm->frame->data, strm->frame->nb_samples, (const uint8_t **) planes, strm->sample_count);
+	}
 #elif defined(HAVE_AVRESAMPLE)
-	strm->frame->nb_samples = avresample_convert(strm->resampler_cxt, (uint8_t **) strm->frame->data, 0, strm->frame->nb_samples, (uint8_t **) &strm->samples, 0, strm->sample_count);
+	{
+		uint8_t *planes[AV_PCM_MAX_CHANNELS];
+		av_get_pcm_planes(strm, planes);
+		strm->frame->nb_samples = avresample_convert(strm->resampler_cxt, (uint8_t **) strm->frame->data, 0, strm->frame->nb_samples, planes, 0, strm->sample_count);
+	}
 #else
 	if(strm->sample_count > 0) {
 		uint8_t *cursor = strm->resampler_queue + strm->resampler_queue_length * strm->target_sample_size;
@@ -1821,66 +2787,8 @@ static void av_transfer_pcm_to_frame(av_stream *strm) {
 		strm->resampler_queue_length -= strm->codec_cxt->frame_size;
 	}
 
-	if(strm->codec_cxt->sample_fmt >= AV_SAMPLE_FMT_U8P && strm->codec_cxt->sample_fmt <= AV_SAMPLE_FMT_DBLP) {
-		int32_t i, j;
-		switch(strm->codec_cxt->sample_fmt) {
-			case AV_SAMPLE_FMT_U8P: {
-				int8_t *src_pointer = (int8_t *) strm->resampler_queue;
-				int8_t **dest_pointers = (int8_t **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						int8_t *dest_pointer = dest_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						src_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_S16P: {
-				int16_t *src_pointer = (int16_t *) strm->resampler_queue;
-				int16_t **dest_pointers = (int16_t **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						int16_t *dest_pointer = dest_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						src_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_S32P: {
-				int32_t *src_pointer = (int32_t *) strm->resampler_queue;
-				int32_t **dest_pointers = (int32_t **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						int32_t *dest_pointer = dest_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						src_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_FLTP: {
-				float *src_pointer = (float *) strm->resampler_queue;
-				float **dest_pointers = (float **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						float *dest_pointer = dest_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						src_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_DBLP: {
-				double *src_pointer = (double *) strm->resampler_queue;
-				double **dest_pointers = (double **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						double *dest_pointer = dest_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						src_pointer++;
-					}
-				}
-			}	break;
-			default: break;
-		}
+	if(strm->deinterleave) {
+		av_deinterleave_samples(strm->frame->data, strm->resampler_queue, strm->codec_cxt->channels, av_get_bytes_per_sample(strm->codec_cxt->sample_fmt), strm->frame->nb_samples);
 	} else {
 		memcpy(strm->frame->data[0], strm->resampler_queue, strm->frame->nb_samples * strm->target_sample_size);
 	}
@@ -1892,77 +2800,36 @@ static void av_transfer_pcm_to_frame(av_stream *strm) {
 }
 
 static void av_transfer_pcm_from_frame(av_stream *strm) {
-	uint32_t sample_count = (uint32_t) ceil(strm->frame_duration * 44100);
-	if(strm->sample_buffer_size < sample_count) {
-		strm->sample_buffer_size = sample_count;
-		strm->samples = erealloc(strm->samples, sizeof(float) * strm->sample_buffer_size * 2 + FF_INPUT_BUFFER_PADDING_SIZE);
+	uint32_t sample_count = (strm->pcm_passthrough) ? strm->frame->nb_samples : (uint32_t) ceil(strm->frame_duration * strm->pcm_sample_rate);
+	if(strm->sample_buffer_size < sample_count || !strm->samples) {
+		if(strm->sample_buffer_size < sample_count) {
+			strm->sample_buffer_size = sample_count;
+		}
+		strm->samples = erealloc(strm->samples, strm->pcm_sample_size * strm->pcm_channels * strm->sample_buffer_size + FF_INPUT_BUFFER_PADDING_SIZE);
+	}
+	if(strm->pcm_passthrough) {
+		uint8_t *planes[AV_PCM_MAX_CHANNELS];
+		av_get_pcm_planes(strm, planes);
+		av_samples_copy(planes, strm->frame->extended_data, 0, 0, strm->frame->nb_samples, strm->pcm_channels, strm->pcm_sample_fmt);
+		strm->sample_count = strm->frame->nb_samples;
+		return;
 	}
 #if defined(HAVE_SWRESAMPLE)
-	strm->sample_count = swr_convert(strm->resampler_cxt, (uint8_t **) &strm->samples, strm->sample_buffer_size, (const uint8_t **) strm->frame->data, strm->frame->nb_samples);
+	{
+		uint8_t *planes[AV_PCM_MAX_CHANNELS];
+		av_get_pcm_planes(strm, planes);
+		strm->sample_count = swr_convert(strm->resampler_cxt, planes, strm->sample_buffer_size, (const uint8_t **) strm->frame->data, strm->frame->nb_samples);
+	}
 #elif defined(HAVE_AVRESAMPLE)
-	strm->sample_count = avresample_convert(strm->resampler_cxt, (uint8_t **) &strm->samples, 0, strm->sample_buffer_size, (uint8_t **) strm->frame->data, 0, strm->frame->nb_samples);
+	{
+		uint8_t *planes[AV_PCM_MAX_CHANNELS];
+		av_get_pcm_planes(strm, planes);
+		strm->sample_count = avresample_convert(strm->resampler_cxt, planes, 0, strm->sample_buffer_size, (uint8_t **) strm->frame->data, 0, strm->frame->nb_samples);
+	}
 #else
 	uint8_t *src_buffer;
 	if(strm->deinterleave) {
-		int32_t i, j;
-		switch(strm->codec_cxt->sample_fmt) {
-			case AV_SAMPLE_FMT_U8P: {
-				int8_t *dest_pointer = (int8_t *) strm->resampler_queue;
-				int8_t **src_pointers = (int8_t **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						int8_t *src_pointer = src_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						dest_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_S16P: {
-				int16_t *dest_pointer = (int16_t *) strm->resampler_queue;
-				int16_t **src_pointers = (int16_t **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						int16_t *src_pointer = src_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						dest_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_S32P: {
-				int32_t *dest_pointer = (int32_t *) strm->resampler_queue;
-				int32_t **src_pointers = (int32_t **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						int32_t *src_pointer = src_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						dest_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_FLTP: {
-				float *dest_pointer = (float *) strm->resampler_queue;
-				float **src_pointers = (float **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						float *src_pointer = src_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						dest_pointer++;
-					}
-				}
-			}	break;
-			case AV_SAMPLE_FMT_DBLP: {
-				double *dest_pointer = (double *) strm->resampler_queue;
-				double **src_pointers = (double **) strm->frame->data;
-				for(i = 0; i < strm->frame->nb_samples; i++) {
-					for(j = 0; j < strm->codec_cxt->channels; j++) {
-						double *src_pointer = src_pointers[j] + i;
-						*dest_pointer = *src_pointer;
-						dest_pointer++;
-					}
-				}
-			}	break;
-			default: break;
-		}
+		av_interleave_samples(strm->resampler_queue, strm->frame->data, strm->codec_cxt->channels, av_get_bytes_per_sample(strm->codec_cxt->sample_fmt), strm->frame->nb_samples);
 		src_buffer = strm->resampler_queue;
 	} else {
 		src_buffer = strm->frame->data[0];
@@ -1972,20 +2839,9 @@ static void av_transfer_pcm_from_frame(av_stream *strm) {
 }
 
 static void av_copy_image_from_gd(AVFrame *picture, gdImagePtr image) {
-	int *gd_pixel;
-	uint8_t *av_pixel;
-	uint32_t i, j;
+	uint32_t i;
 	for(i = 0; i < (uint32_t) image->sy; i++) {
-		gd_pixel = image->tpixels[i];
-		av_pixel = picture->data[0] + picture->linesize[0] * i;
-		for(j = 0; j < (uint32_t) image->sx; j++) {
-			av_pixel[0] = gdTrueColorGetRed(*gd_pixel);
-			av_pixel[1] = gdTrueColorGetGreen(*gd_pixel);
-			av_pixel[2] = gdTrueColorGetBlue(*gd_pixel);
-			av_pixel[3] = (gdAlphaMax - gdTrueColorGetAlpha(*gd_pixel)) << 1;
-			gd_pixel += 1;
-			av_pixel += 4;
-		}
+		av_gd_to_rgba(picture->data[0] + picture->linesize[0] * i, image->tpixels[i], image->sx);
 	}
 }
 
@@ -2106,10 +2962,7 @@ static int av_encode_next_frame(av_stream *strm, double time) {
 		return FALSE;
 	}
 
-	packet = emalloc(sizeof(AVPacket));
-	av_init_packet(packet);
-	packet->data = NULL;
-	packet->size = 0;
+	packet = av_acquire_packet(strm->file);
 
 	switch(strm->codec->type) {
 		case AVMEDIA_TYPE_VIDEO:
@@ -2125,12 +2978,31 @@ static int av_encode_next_frame(av_stream *strm, double time) {
 	if(packet_finished) {
 		av_write_next_packet(strm, packet);
 	} else {
-		av_free_packet(packet);
-		efree(packet);
+		av_release_packet(strm->file, packet);
 	}
 	return !(result < 0);
 }
 
+static void av_begin_roll_forward(av_stream *strm) {
+	// frames that nothing references can be skipped while decoding towards the time sought,
+	// as long as the ones near it (including those held back by reordering and frame threading) are decoded
+	if(strm->codec->type == AVMEDIA_TYPE_VIDEO && strm->codec_cxt->skip_frame == AVDISCARD_DEFAULT && !(strm->flags & AV_STREAM_FULL_ROLL_FORWARD)) {
+		AVRational frame_rate = strm->stream->avg_frame_rate;
+		double frame_duration = (frame_rate.num && frame_rate.den) ? 1 / av_q2d(frame_rate) : 0.1;
+		int delay = strm->codec_cxt->has_b_frames + strm->codec_cxt->thread_count + 2;
+		strm->codec_cxt->skip_frame = AVDISCARD_NONREF;
+		strm->roll_forward_end_time = strm->time_sought - frame_duration * delay;
+		strm->flags |= AV_STREAM_ROLLING_FORWARD;
+	}
+}
+
+static void av_end_roll_forward(av_stream *strm) {
+	if(strm->flags & AV_STREAM_ROLLING_FORWARD) {
+		strm->codec_cxt->skip_frame = AVDISCARD_DEFAULT;
+		strm->flags &= ~AV_STREAM_ROLLING_FORWARD;
+	}
+}
+
 static int av_decode_frame_at_cursor(av_stream *strm, AVFrame *dest_frame, double *p_time TSRMLS_DC) {
 	int frame_finished = FALSE;
 	strm->frame_pts = AV_NOPTS_VALUE;
@@ -2138,6 +3010,13 @@ static int av_decode_frame_at_cursor(av_stream *strm, AVFrame *dest_frame, doubl
 	for(;;) {
 		int bytes_decoded;
 		if(av_read_next_packet(strm TSRMLS_CC)) {
+			if(strm->flags & AV_STREAM_ROLLING_FORWARD) {
+				// go back to full decoding once the packets get close to the time sought
+				int64_t time_stamp = (strm->packet->pts != AV_NOPTS_VALUE) ? strm->packet->pts : strm->packet->dts;
+				if(time_stamp == AV_NOPTS_VALUE || time_stamp * av_q2d(strm->stream->time_base) >= strm->roll_forward_end_time) {
+					av_end_roll_forward(strm);
+				}
+			}
 			switch(strm->codec->type) {
 				case AVMEDIA_TYPE_VIDEO:
 					bytes_decoded = avcodec_decode_video2(strm->codec_cxt, dest_frame, &frame_finished, strm->packet);
@@ -2195,6 +3074,7 @@ static int av_decode_next_frame(av_stream *strm, double *p_time TSRMLS_DC) {
 		// keep decoding frames until we have two frames straddling the time sought
 		AVFrame *current_frame = strm->frame, *next_frame = NULL;
 		double current_frame_time, next_frame_time = 0;
+		av_begin_roll_forward(strm);
 		do {
 			if(next_frame) {
 				// the one read earlier become the current frame
@@ -2205,6 +3085,7 @@ static int av_decode_next_frame(av_stream *strm, double *p_time TSRMLS_DC) {
 			} else {
 				// decode the current frame
 				if(!av_decode_frame_at_cursor(strm, current_frame, &current_frame_time TSRMLS_CC)) {
+					av_end_roll_forward(strm);
 					return FALSE;
 				}
 				if(current_frame_time == strm->time_sought) {
@@ -2222,6 +3103,7 @@ static int av_decode_next_frame(av_stream *strm, double *p_time TSRMLS_DC) {
 			}
 		} while(!(current_frame_time <= strm->time_sought && strm->time_sought < next_frame_time) && next_frame_time < strm->time_sought);
 
+		av_end_roll_forward(strm);
 		strm->flags &= ~AV_STREAM_SOUGHT;
 		strm->frame = current_frame;
 		strm->next_frame = next_frame;
@@ -2253,18 +3135,14 @@ static int av_encode_next_subtitle(av_stream *strm, double time) {
 		return FALSE;
 	}
 
-	packet = emalloc(sizeof(AVPacket));
-	av_init_packet(packet);
-	packet->data = NULL;
-	packet->size = 0;
+	packet = av_acquire_packet(strm->file);
 
 	result = avcodec_encode_subtitle2(strm->codec_cxt, packet, strm->subtitle, &packet_finished);
 
 	if(packet_finished) {
 		av_write_next_packet(strm, packet);
 	} else {
-		av_free_packet(packet);
-		efree(packet);
+		av_release_packet(strm->file, packet);
 	}
 	return !(result < 0);
 }
@@ -2329,87 +3207,381 @@ static int av_encode_image_from_gd(av_stream *strm, gdImagePtr image, double tim
 	return av_encode_next_frame(strm, time);
 }
 
-static int av_decode_image_to_gd(av_stream *strm, gdImagePtr image, double *p_time TSRMLS_DC) {
-	if(av_decode_next_frame(strm, p_time TSRMLS_CC)) {
+static int av_encode_frame_from_planes(av_stream *strm, uint8_t **data, int *linesize, enum AVPixelFormat pix_fmt, int width, int height, double time) {
+	int result;
+	if(isnan(time)) {
+		time = strm->next_frame_time;
+	}
+	strm->next_frame_time = time + strm->frame_duration;
+	if(pix_fmt == strm->codec_cxt->pix_fmt && width == strm->codec_cxt->width && height == strm->codec_cxt->height) {
+		// copy the planes into the frame's own buffer, which is aligned the way the encoder expects
+		av_allocate_frame_buffer(strm);
+		av_image_copy(strm->frame->data, strm->frame->linesize, (const uint8_t **) data, linesize, pix_fmt, width, height);
+		result = av_encode_next_frame(strm, time);
+	} else {
+		av_create_scaler(strm, width, height, pix_fmt, FOR_ENCODING);
+		av_allocate_frame_buffer(strm);
+		av_scale_picture(strm, (const uint8_t * const *) data, linesize, strm->frame->data, strm->frame->linesize);
+		result = av_encode_next_frame(strm, time);
+	}
+	return result;
+}
+
+static int av_transfer_frame_to_gd(av_stream *strm, gdImagePtr image) {
+	uint8_t *data[4] = { NULL, NULL, NULL, NULL };
+	int linesize[4] = { 0, 0, 0, 0 };
+	const AVPixFmtDescriptor *desc;
+	int has_alpha;
+	int32_t i;
+
+	if(!image->trueColor || image->sy < 1) {
+		return FALSE;
+	}
+	// PIX_FMT_RGB32 is ARGB in native-endian 32-bit integers, same as gd; gd allocates
+	// each row separately, so scale into an aligned buffer and convert the rows while
+	// copying them over
+	av_create_scaler(strm, image->sx, image->sy, PIX_FMT_RGB32, FOR_DECODING);
+	av_create_picture(strm, image->sx, image->sy);
+	data[0] = strm->picture->data[0];
+	linesize[0] = strm->picture->linesize[0];
+	av_scale_picture(strm, (const uint8_t * const *) strm->frame->data, strm->frame->linesize, data, linesize);
+
+	desc = av_pix_fmt_desc_get(strm->codec_cxt->pix_fmt);
+	has_alpha = desc && (desc->flags & PIX_FMT_ALPHA);
+	for(i = 0; i < image->sy; i++) {
+		av_rgb32_to_gd(image->tpixels[i], (const uint32_t *) (data[0] + linesize[0] * i), image->sx, has_alpha);
+	}
+	return TRUE;
+}
+
+static void av_convert_frame_to_gd(av_stream *strm, gdImagePtr image) {
+	if(!av_transfer_frame_to_gd(strm, image)) {
 		av_create_picture_and_scaler(strm, image->sx, image->sy, FOR_DECODING);
 		av_transfer_picture_from_frame(strm);
 		av_copy_image_to_gd(strm->picture, image);
-		return TRUE;
 	}
-	return FALSE;
 }
 
-static int av_encode_pcm_from_zval(av_stream *strm, zval *buffer, double time TSRMLS_DC) {
-	float *src_samples, *dst_samples;
-	uint32_t src_samples_remaining;
-	int result;
+static void av_reduce_frame_to_grid(av_stream *strm, uint8_t *grid, int grid_width, int grid_height) {
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(strm->codec_cxt->pix_fmt);
+	if(desc && !(desc->flags & (PIX_FMT_RGB | PIX_FMT_PAL | PIX_FMT_PSEUDOPAL | PIX_FMT_HWACCEL | PIX_FMT_BITSTREAM))
+	 && desc->comp[0].plane == 0 && desc->comp[0].step_minus1 == 0 && desc->comp[0].depth_minus1 == 7) {
+		// the first plane holds 8-bit luma--average it directly
+		av_reduce_luma_plane(strm->frame->data[0], strm->frame->linesize[0], strm->codec_cxt->width, strm->codec_cxt->height, grid, grid_width, grid_height);
+	} else {
+		uint8_t *data[4] = { grid, NULL, NULL, NULL };
+		int linesize[4] = { grid_width, 0, 0, 0 };
+		av_create_scaler(strm, grid_width, grid_height, PIX_FMT_GRAY8, FOR_DECODING);
+		av_scale_picture(strm, (const uint8_t * const *) strm->frame->data, strm->frame->linesize, data, linesize);
+	}
+}
 
-	if(Z_TYPE_P(buffer) != IS_STRING) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Audio data must be contained in a string");
-		return FALSE;
+static int av_get_plane_layout(enum AVPixelFormat pix_fmt, int width, int height, int align, int *linesize, int *rows) {
+	// return the number of planes, along with the bytes per row and the number of rows in each
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+	int i;
+	av_image_fill_linesizes(linesize, pix_fmt, width);
+	for(i = 0; i < 4 && linesize[i] > 0; i++) {
+		linesize[i] = FFALIGN(linesize[i], align);
+		rows[i] = (i == 1 || i == 2) ? -((-height) >> desc->log2_chroma_h) : height;
 	}
+	return i;
+}
 
-	av_create_audio_buffer_and_resampler(strm, FOR_ENCODING);
+static void av_copy_planes_to_zval(zval *z_frame, uint8_t * const *data, const int *linesize, enum AVPixelFormat pix_fmt, int width, int height) {
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+	int packed_linesize[4], rows[4];
+	zval *z_planes, *z_linesizes;
+	int i, plane_count;
+
+	MAKE_STD_ZVAL(z_planes);
+	array_init(z_planes);
+	MAKE_STD_ZVAL(z_linesizes);
+	array_init(z_linesizes);
+	// rows are packed without padding
+	plane_count = av_get_plane_layout(pix_fmt, width, height, 1, packed_linesize, rows);
+	for(i = 0; i < plane_count && data[i]; i++) {
+		uint32_t size = packed_linesize[i] * rows[i];
+		uint8_t *buffer = emalloc(size + 1);
+		av_image_copy_plane(buffer, packed_linesize[i], data[i], linesize[i], packed_linesize[i], rows[i]);
+		buffer[size] = '\0';
+		add_next_index_stringl(z_planes, (char *) buffer, size, 0);
+		add_next_index_long(z_linesizes, packed_linesize[i]);
+	}
+	zend_hash_update(HASH_OF(z_frame), "planes", (uint32_t) strlen("planes") + 1, (void *) &z_planes, sizeof(zval *), NULL);
+	zend_hash_update(HASH_OF(z_frame), "linesizes", (uint32_t) strlen("linesizes") + 1, (void *) &z_linesizes, sizeof(zval *), NULL);
+	if(desc->flags & PIX_FMT_PAL) {
+		av_set_element_stringl(z_frame, "palette", (const char *) data[1], AVPALETTE_SIZE);
+	}
+}
 
-	// source samples are assumed to be stereo--hence the x2
-	src_samples = (float *) Z_STRVAL_P(buffer);
-	src_samples_remaining = Z_STRLEN_P(buffer) / (sizeof(float) * 2);
-	dst_samples = strm->samples + strm->sample_count * 2;
+#define AV_SHARED_FRAME_ALIGNMENT		32
+#define AV_SHARED_FRAME_PADDING			64		// room for scalers that write past the end of the last row
 
-	if(!isnan(time)) {
-		double buffered_duration = strm->sample_count * (1 / 44100.0);
-		double start_time = time - buffered_duration;
-		double error = strm->sample_start_time - start_time;
+static av_shared_frame_ring *av_create_shared_frame_ring(const char *name, uint32_t slot_count, uint64_t slot_size, int *p_result) {
+	av_shared_frame_ring *ring = emalloc(sizeof(av_shared_frame_ring));
+	uint32_t header_size = FFALIGN(sizeof(av_shared_frame_header) + sizeof(av_shared_frame_slot) * slot_count, 4096);
+	uint64_t total_size = header_size + slot_size * slot_count;
 
-		if(fabs(error) < 0.001) {
-			// the error is small--ignore it
-			strm->sample_start_time = start_time;
-		} else {
-			if(strm->sample_count > 0) {
-				// start a new packet
-				av_transfer_pcm_to_frame(strm);
-				result = av_encode_next_frame(strm, strm->sample_start_time);
-				strm->sample_count = 0;
-				if(!result) {
-					return FALSE;
-				}
-			}
-			strm->sample_start_time = time;
-			dst_samples = strm->samples;
-		}
+	memset(ring, 0, sizeof(av_shared_frame_ring));
+	*p_result = (total_size <= (size_t) -1) ? av_shared_memory_create(&ring->memory, name, (size_t) total_size) : FALSE;
+	if(*p_result != TRUE) {
+		efree(ring);
+		return NULL;
 	}
+	memset(ring->memory.base, 0, header_size);
+	ring->header = (av_shared_frame_header *) ring->memory.base;
+	ring->slots = (av_shared_frame_slot *) (ring->memory.base + sizeof(av_shared_frame_header));
+	ring->header->version = AV_SHARED_FRAME_VERSION;
+	ring->header->slot_count = slot_count;
+	ring->header->header_size = header_size;
+	ring->header->slot_size = slot_size;
+	AV_MEMORY_BARRIER();
+	ring->header->magic = AV_SHARED_FRAME_MAGIC;
+	return ring;
+}
 
-	// keep copying into audio frame until are samples are used up
-	while(src_samples_remaining) {
-		uint32_t samples_needed = strm->sample_buffer_size - strm->sample_count;
-		uint32_t samples_to_copy;
-		uint32_t i;
+static void av_free_shared_frame_ring(av_shared_frame_ring *ring) {
+	av_shared_memory_destroy(&ring->memory);
+	efree(ring);
+}
 
-#ifdef RESAMPLER_REQUIRES_EXTRA_SAMPLES
-		if(strm->resampler_extra_sample_count > 0) {
-			samples_needed += strm->resampler_extra_sample_count;
+static int av_write_frame_to_shared_memory(av_stream *strm, zval *z_frame, enum AVPixelFormat pix_fmt, int width, int height TSRMLS_DC) {
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+	av_shared_frame_ring *ring = strm->shared_frames;
+	av_shared_frame_slot *slot;
+	uint8_t *data[4] = { NULL, NULL, NULL, NULL };
+	int linesize[4] = { 0, 0, 0, 0 }, rows[4];
+	uint64_t plane_offset[4], size = 0, offset, generation;
+	zval *z_linesizes, *z_plane_offsets;
+	int i, plane_count;
+
+	plane_count = av_get_plane_layout(pix_fmt, width, height, AV_SHARED_FRAME_ALIGNMENT, linesize, rows);
+	for(i = 0; i < plane_count; i++) {
+		plane_offset[i] = size;
+		size += (uint64_t) linesize[i] * rows[i];
+	}
+	if(!ring) {
+		uint64_t slot_size = strm->shared_memory_slot_size;
+		int result;
+		if(!slot_size) {
+			// make the slots just big enough for the first frame
+			slot_size = FFALIGN(size + AV_SHARED_FRAME_PADDING, 4096);
 		}
-#endif
-
-		if(samples_needed < src_samples_remaining) {
-			samples_to_copy = samples_needed;
-		} else {
-			samples_to_copy = src_samples_remaining;
+		ring = strm->shared_frames = av_create_shared_frame_ring(strm->shared_memory_name, strm->shared_memory_slot_count, slot_size, &result);
+		if(!ring) {
+			if(result == AV_SHARED_MEMORY_EXISTS) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Shared memory '%s' already exists", strm->shared_memory_name);
+			} else {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to create shared memory '%s'", strm->shared_memory_name);
+			}
+			return FALSE;
 		}
+	}
+	if(size + AV_SHARED_FRAME_PADDING > ring->header->slot_size) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Frame does not fit in a shared memory slot of %lu bytes", (unsigned long) ring->header->slot_size);
+		return FALSE;
+	}
 
-		// make sure samples are between (-1.0, 1.0)
-		for(i = 0; i < samples_to_copy * 2; i++) {
-			float sample = src_samples[i];
-			if(EXPECTED(-1.0f <= sample && sample <= 1.0f)) {
-				dst_samples[i] = sample;
-			} else {
-				dst_samples[i] = (sample < -1) ? -1.0f : 1.0f;
+	// mark the slot as being written, so readers still holding an older frame can tell it's gone
+	generation = ++ring->generation;
+	slot = &ring->slots[(generation - 1) % ring->header->slot_count];
+	offset = ring->header->header_size + ring->header->slot_size * ((generation - 1) % ring->header->slot_count);
+	slot->sequence = generation * 2 - 1;
+	AV_MEMORY_BARRIER();
+	for(i = 0; i < plane_count; i++) {
+		data[i] = ring->memory.base + offset + plane_offset[i];
+	}
+	if(pix_fmt == strm->codec_cxt->pix_fmt && width == strm->codec_cxt->width && height == strm->codec_cxt->height) {
+		int bytewidth[4];
+		av_image_fill_linesizes(bytewidth, pix_fmt, width);
+		for(i = 0; i < plane_count; i++) {
+			av_image_copy_plane(data[i], linesize[i], strm->frame->data[i], strm->frame->linesize[i], bytewidth[i], rows[i]);
+		}
+	} else {
+		// convert straight into shared memory
+		av_create_scaler(strm, width, height, pix_fmt, FOR_DECODING);
+		av_scale_picture(strm, (const uint8_t * const *) strm->frame->data, strm->frame->linesize, data, linesize);
+	}
+	AV_MEMORY_BARRIER();
+	slot->sequence = generation * 2;
+	ring->header->generation = generation;
+
+	av_set_element_string(z_frame, "shared_memory", strm->shared_memory_name);
+	av_set_element_long(z_frame, "offset", (long) offset);
+	av_set_element_long(z_frame, "size", (long) size);
+	av_set_element_long(z_frame, "generation", (long) generation);
+	MAKE_STD_ZVAL(z_linesizes);
+	array_init(z_linesizes);
+	MAKE_STD_ZVAL(z_plane_offsets);
+	array_init(z_plane_offsets);
+	for(i = 0; i < plane_count; i++) {
+		add_next_index_long(z_linesizes, linesize[i]);
+		add_next_index_long(z_plane_offsets, (long) plane_offset[i]);
+	}
+	zend_hash_update(HASH_OF(z_frame), "linesizes", (uint32_t) strlen("linesizes") + 1, (void *) &z_linesizes, sizeof(zval *), NULL);
+	zend_hash_update(HASH_OF(z_frame), "plane_offsets", (uint32_t) strlen("plane_offsets") + 1, (void *) &z_plane_offsets, sizeof(zval *), NULL);
+	if(desc->flags & PIX_FMT_PAL) {
+		av_set_element_stringl(z_frame, "palette", (const char *) strm->frame->data[1], AVPALETTE_SIZE);
+	}
+	return TRUE;
+}
+
+static int av_decode_image_to_gd(av_stream *strm, gdImagePtr image, double *p_time TSRMLS_DC) {
+	if(av_decode_next_frame(strm, p_time TSRMLS_CC)) {
+		av_convert_frame_to_gd(strm, image);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static int av_roll_forward(av_stream *strm, double time_sought, double *p_time TSRMLS_DC) {
+	// strm->frame holds the frame at *p_time; keep decoding until the next frame is past the time sought
+	AVFrame *next_frame = strm->next_frame;
+	double current_frame_time = *p_time, next_frame_time = strm->next_frame_time;
+	int next_frame_decoded = (next_frame != NULL);
+
+	strm->time_sought = time_sought;
+	av_begin_roll_forward(strm);
+	for(;;) {
+		if(!next_frame_decoded) {
+			if(!next_frame) {
+				next_frame = avcodec_alloc_frame();
 			}
+			if(!av_decode_frame_at_cursor(strm, next_frame, &next_frame_time TSRMLS_CC)) {
+				avcodec_free_frame(&next_frame);
+				next_frame = NULL;
+				break;
+			}
+		}
+		if(next_frame_time > time_sought) {
+			break;
 		}
-		src_samples_remaining -= samples_to_copy;
+		// the next frame becomes the current frame and its buffer is reused
+		{
+			AVFrame *current_frame = strm->frame;
+			strm->frame = next_frame;
+			next_frame = current_frame;
+			current_frame_time = next_frame_time;
+			next_frame_decoded = FALSE;
+		}
+	}
+	av_end_roll_forward(strm);
+	strm->next_frame = next_frame;
+	strm->next_frame_time = (next_frame) ? next_frame_time : 0;
+	*p_time = current_frame_time;
+	return TRUE;
+}
+
+static int av_get_key_frame_index(av_stream *strm, double time) {
+	int64_t time_stamp = (int64_t) (time / av_q2d(strm->stream->time_base));
+	// the demuxer can reallocate the index while reading
+	av_pause_prefetch(strm->file);
+	return av_index_search_timestamp(strm->stream, time_stamp, AVSEEK_FLAG_BACKWARD);
+}
+
+static void av_copy_pcm_plane(av_stream *strm, uint8_t *dst, const uint8_t *src, uint32_t count) {
+	// make sure samples are between (-1.0, 1.0)--integer formats cannot go out of range
+	if(!(strm->flags & AV_STREAM_TRUSTED_INPUT)) {
+		switch(av_get_packed_sample_fmt(strm->pcm_sample_fmt)) {
+			case AV_SAMPLE_FMT_FLT: {
+				av_copy_clamped_float((float *) dst, (const float *) src, count);
+			}	return;
+			case AV_SAMPLE_FMT_DBL: {
+				double *d_dst = (double *) dst;
+				const double *d_src = (const double *) src;
+				uint32_t i;
+				for(i = 0; i < count; i++) {
+					double sample = d_src[i];
+					if(EXPECTED(-1.0 <= sample && sample <= 1.0)) {
+						d_dst[i] = sample;
+					} else {
+						d_dst[i] = (sample < -1) ? -1.0 : 1.0;
+					}
+				}
+			}	return;
+			default: break;
+		}
+	}
+	memcpy(dst, src, count * strm->pcm_sample_size);
+}
+
+static void av_copy_pcm_samples(av_stream *strm, const uint8_t *src_samples, uint32_t src_sample_count, uint32_t src_offset, uint32_t count) {
+	uint8_t *planes[AV_PCM_MAX_CHANNELS];
+	uint32_t frame_size = strm->pcm_sample_size * strm->pcm_channels;
+
+	av_get_pcm_planes(strm, planes);
+	if(av_sample_fmt_is_planar(strm->pcm_sample_fmt)) {
+		// channels follow one another in the source string
+		int c;
+		for(c = 0; c < strm->pcm_channels; c++) {
+			uint8_t *dst = planes[c] + strm->sample_count * strm->pcm_sample_size;
+			av_copy_pcm_plane(strm, dst, src_samples + (src_sample_count * c + src_offset) * strm->pcm_sample_size, count);
+		}
+	} else {
+		uint8_t *dst = planes[0] + strm->sample_count * frame_size;
+		av_copy_pcm_plane(strm, dst, src_samples + src_offset * frame_size, count * strm->pcm_channels);
+	}
+}
+
+static int av_encode_pcm_from_zval(av_stream *strm, zval *buffer, double time TSRMLS_DC) {
+	const uint8_t *src_samples;
+	uint32_t src_sample_count, src_offset = 0;
+	int result;
+
+	if(Z_TYPE_P(buffer) != IS_STRING) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Audio data must be contained in a string");
+		return FALSE;
+	}
+
+	av_create_audio_buffer_and_resampler(strm, FOR_ENCODING);
+
+	src_samples = (const uint8_t *) Z_STRVAL_P(buffer);
+	src_sample_count = Z_STRLEN_P(buffer) / (strm->pcm_sample_size * strm->pcm_channels);
+
+	if(!isnan(time)) {
+		double buffered_duration = (double) strm->sample_count / strm->pcm_sample_rate;
+		double start_time = time - buffered_duration;
+		double error = strm->sample_start_time - start_time;
+
+		if(fabs(error) < 0.001) {
+			// the error is small--ignore it
+			strm->sample_start_time = start_time;
+		} else {
+			if(strm->sample_count > 0) {
+				// start a new packet
+				av_transfer_pcm_to_frame(strm);
+				result = av_encode_next_frame(strm, strm->sample_start_time);
+				strm->sample_count = 0;
+				if(!result) {
+					return FALSE;
+				}
+			}
+			strm->sample_start_time = time;
+		}
+	}
+
+	// keep copying into audio frame until are samples are used up
+	while(src_offset < src_sample_count) {
+		uint32_t samples_needed = strm->sample_buffer_size - strm->sample_count;
+		uint32_t samples_remaining = src_sample_count - src_offset;
+		uint32_t samples_to_copy;
+
+#ifdef RESAMPLER_REQUIRES_EXTRA_SAMPLES
+		if(strm->resampler_extra_sample_count > 0) {
+			samples_needed += strm->resampler_extra_sample_count;
+		}
+#endif
+
+		if(samples_needed < samples_remaining) {
+			samples_to_copy = samples_needed;
+		} else {
+			samples_to_copy = samples_remaining;
+		}
+
+		av_copy_pcm_samples(strm, src_samples, src_sample_count, src_offset, samples_to_copy);
+		src_offset += samples_to_copy;
 		strm->sample_count += samples_to_copy;
-		src_samples += samples_to_copy * 2;
-		dst_samples += samples_to_copy * 2;
 
 		if(strm->sample_count >= strm->sample_buffer_size) {
 			// transfer the data to the frame then compress it
@@ -2417,12 +3589,11 @@ static int av_encode_pcm_from_zval(av_stream *strm, zval *buffer, double time TS
 			result = av_encode_next_frame(strm, strm->sample_start_time);
 
 			// adjust the time
-			strm->sample_start_time += strm->sample_count * (1 / 44100.0);
+			strm->sample_start_time += (double) strm->sample_count / strm->pcm_sample_rate;
 			strm->sample_count = 0;
 #ifdef RESAMPLER_REQUIRES_EXTRA_SAMPLES
 			strm->resampler_extra_sample_count = 0;
 #endif
-			dst_samples = strm->samples;
 
 			if(!result) {
 				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to encode audio packet");
@@ -2434,25 +3605,93 @@ static int av_encode_pcm_from_zval(av_stream *strm, zval *buffer, double time TS
 }
 
 
-static int av_decode_pcm_to_zval(av_stream *strm, zval *buffer, double *p_time TSRMLS_DC) {
-	if(av_decode_next_frame(strm, p_time TSRMLS_CC)) {
-		int data_len;
-		char *data;
+static int av_decode_pcm_to_zval(av_stream *strm, zval *buffer, double *p_time, uint32_t min_samples, double min_duration TSRMLS_DC) {
+	char *data = NULL;
+	uint32_t plane_count = 1, unit_size = 0, plane_capacity = 0, total = 0, frame_count = 0, i;
+	double frame_time;
+	int data_len;
+
+	// keep decoding until enough samples have been gathered
+	while(frame_count == 0 || total < min_samples) {
+		uint8_t *planes[AV_PCM_MAX_CHANNELS];
 
+		if(!av_decode_next_frame(strm, (total == 0) ? p_time : &frame_time TSRMLS_CC)) {
+			break;
+		}
 		av_create_audio_buffer_and_resampler(strm, FOR_DECODING);
 		av_transfer_pcm_from_frame(strm);
 
-		data_len = sizeof(float) * 2 * strm->sample_count;
-		if(Z_TYPE_P(buffer) != IS_STRING || Z_STRLEN_P(buffer) < data_len) {
+		if(frame_count++ == 0) {
+			uint32_t required_capacity, max_samples;
+
+			// each plane gets its own region of the string; gaps are closed up at the end
+			if(av_sample_fmt_is_planar(strm->pcm_sample_fmt)) {
+				plane_count = strm->pcm_channels;
+				unit_size = strm->pcm_sample_size;
+			} else {
+				plane_count = 1;
+				unit_size = strm->pcm_sample_size * strm->pcm_channels;
+			}
+			// the string cannot be longer than INT_MAX; leave room for growing by a few frames
+			max_samples = (INT_MAX - 1) / (plane_count * unit_size) / 2;
+			if(min_duration > 0) {
+				double duration_samples = ceil(min_duration * strm->pcm_sample_rate);
+				if(min_samples < duration_samples) {
+					min_samples = (duration_samples < max_samples) ? (uint32_t) duration_samples : max_samples;
+				}
+			}
+			if(min_samples > max_samples) {
+				min_samples = max_samples;
+			}
+			required_capacity = (min_samples > strm->sample_count) ? min_samples + strm->sample_buffer_size : strm->sample_count;
+
+			// reuse the buffer from the previous call if it's large enough
+			if(Z_TYPE_P(buffer) == IS_STRING && (uint32_t) Z_STRLEN_P(buffer) >= required_capacity * plane_count * unit_size) {
+				data = Z_STRVAL_P(buffer);
+				plane_capacity = Z_STRLEN_P(buffer) / (plane_count * unit_size);
+			} else {
+				zval_dtor(buffer);
+				data = safe_emalloc(required_capacity, plane_count * unit_size, 1);
+				plane_capacity = required_capacity;
+				Z_TYPE_P(buffer) = IS_STRING;
+				Z_STRVAL_P(buffer) = data;
+				Z_STRLEN_P(buffer) = required_capacity * plane_count * unit_size;
+			}
+		}
+		if(total + strm->sample_count > plane_capacity) {
+			uint32_t new_capacity = plane_capacity * 2;
+			char *new_data;
+			if(new_capacity < total + strm->sample_count) {
+				new_capacity = total + strm->sample_count;
+			}
+			if(new_capacity > (INT_MAX - 1) / (plane_count * unit_size)) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "PCM data exceeds the maximum string length");
+				break;
+			}
+			new_data = safe_emalloc(new_capacity, plane_count * unit_size, 1);
+			for(i = 0; i < plane_count; i++) {
+				memcpy(new_data + i * new_capacity * unit_size, data + i * plane_capacity * unit_size, total * unit_size);
+			}
 			zval_dtor(buffer);
-			data = emalloc(data_len + 1);
+			data = new_data;
+			plane_capacity = new_capacity;
 			Z_TYPE_P(buffer) = IS_STRING;
 			Z_STRVAL_P(buffer) = data;
-		} else {
-			data = Z_STRVAL_P(buffer);
 		}
+		av_get_pcm_planes(strm, planes);
+		for(i = 0; i < plane_count; i++) {
+			memcpy(data + (i * plane_capacity + total) * unit_size, planes[i], strm->sample_count * unit_size);
+		}
+		total += strm->sample_count;
+	}
+
+	if(frame_count > 0) {
+		// place the channels one after the other
+		for(i = 1; i < plane_count; i++) {
+			memmove(data + i * total * unit_size, data + i * plane_capacity * unit_size, total * unit_size);
+		}
+		data_len = total * plane_count * unit_size;
 		Z_STRLEN_P(buffer) = data_len;
-		memcpy(data, strm->samples, data_len);
 		data[data_len] = '\0';
 		return TRUE;
 	} else {
@@ -2652,6 +3891,123 @@ PHP_FUNCTION(av_stream_write_image)
 }
 /* }}} */
 
+/* {{{ proto bool av_stream_write_frame(resource stream, mixed planes [, array options [, float time]])
+   Write a frame from binary planes, given either as one string or as an array of strings */
+PHP_FUNCTION(av_stream_write_frame)
+{
+	zval *z_strm, *z_planes, *z_options = NULL;
+	av_stream *strm;
+	const AVPixFmtDescriptor *desc;
+	enum AVPixelFormat pix_fmt;
+	long width, height;
+	char *pixel_format_name = NULL;
+	HashTable *linesizes = NULL;
+	uint8_t *data[4] = { NULL, NULL, NULL, NULL };
+	int linesize[4] = { 0, 0, 0, 0 };
+	uint64_t plane_size[4] = { 0, 0, 0, 0 };
+	double time = NAN;
+	int i, plane_count;
+
+	if(zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz|a!d", &z_strm, &z_planes, &z_options, &time) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_VIDEO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a video stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_WRITE)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a writable stream");
+		return;
+	}
+
+	// the data is assumed to be in the codec's format unless stated otherwise
+	pix_fmt = strm->codec_cxt->pix_fmt;
+	width = strm->codec_cxt->width;
+	height = strm->codec_cxt->height;
+	if(av_get_element_string(z_options, "pix_fmt", &pixel_format_name)) {
+		pix_fmt = av_get_pix_fmt(pixel_format_name);
+		if(pix_fmt == AV_PIX_FMT_NONE) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid pixel format '%s'", pixel_format_name);
+			return;
+		}
+	}
+	desc = av_pix_fmt_desc_get(pix_fmt);
+	if(desc->flags & (PIX_FMT_PAL | PIX_FMT_PSEUDOPAL | PIX_FMT_HWACCEL)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Pixel format '%s' is not supported", av_get_pix_fmt_name(pix_fmt));
+		return;
+	}
+	if(pix_fmt != strm->codec_cxt->pix_fmt && !sws_isSupportedInput(pix_fmt)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Cannot convert from pixel format '%s'", av_get_pix_fmt_name(pix_fmt));
+		return;
+	}
+	av_get_element_long(z_options, "width", &width);
+	av_get_element_long(z_options, "height", &height);
+	if(width <= 0 || height <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid dimensions: %ldx%ld", width, height);
+		return;
+	}
+
+	// rows are packed unless linesizes are given
+	av_image_fill_linesizes(linesize, pix_fmt, width);
+	for(plane_count = 0; plane_count < 4 && linesize[plane_count] > 0; plane_count++);
+	if(av_get_element_hash(z_options, "linesizes", &linesizes)) {
+		Bucket *p;
+		for(i = 0, p = linesizes->pListHead; p && i < plane_count; p = p->pListNext, i++) {
+			zval **p_element = p->pData;
+			long value;
+			convert_to_long(*p_element);
+			value = Z_LVAL_PP(p_element);
+			if(value < linesize[i] || value > INT_MAX) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Linesize of plane %d must be at least %d", i, linesize[i]);
+				return;
+			}
+			linesize[i] = value;
+		}
+	}
+	for(i = 0; i < plane_count; i++) {
+		int rows = (i == 1 || i == 2) ? -((-height) >> desc->log2_chroma_h) : height;
+		plane_size[i] = (uint64_t) linesize[i] * rows;
+	}
+
+	if(Z_TYPE_P(z_planes) == IS_STRING) {
+		// planes follow one another in a single buffer
+		uint64_t offset = 0;
+		for(i = 0; i < plane_count; i++) {
+			data[i] = (uint8_t *) Z_STRVAL_P(z_planes) + offset;
+			offset += plane_size[i];
+		}
+		if((uint64_t) Z_STRLEN_P(z_planes) < offset) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Buffer is too small--%lu bytes are needed", (unsigned long) offset);
+			return;
+		}
+	} else if(Z_TYPE_P(z_planes) == IS_ARRAY) {
+		HashTable *ht = Z_ARRVAL_P(z_planes);
+		Bucket *p;
+		for(i = 0, p = ht->pListHead; i < plane_count; i++, p = (p) ? p->pListNext : NULL) {
+			zval **p_element = (p) ? p->pData : NULL;
+			if(!p_element || Z_TYPE_PP(p_element) != IS_STRING || (uint64_t) Z_STRLEN_PP(p_element) < plane_size[i]) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Plane %d should be a string of at least %lu bytes", i, (unsigned long) plane_size[i]);
+				return;
+			}
+			data[i] = (uint8_t *) Z_STRVAL_PP(p_element);
+		}
+	} else {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Parameter 2 should be a string or an array of strings");
+		return;
+	}
+
+	if(av_encode_frame_from_planes(strm, data, linesize, pix_fmt, width, height, time)) {
+		RETURN_TRUE;
+	} else {
+		RETVAL_FALSE;
+	}
+}
+/* }}} */
+
 /* {{{ proto bool av_stream_write_pcm()
    Write audio data */
 PHP_FUNCTION(av_stream_write_pcm)
@@ -2752,15 +4108,190 @@ PHP_FUNCTION(av_stream_read_image)
 }
 /* }}} */
 
+/* {{{ proto array av_stream_read_images(resource stream, mixed images [, callable callback [, int count]])
+   Read a batch of images, returning their times */
+PHP_FUNCTION(av_stream_read_images)
+{
+	zval *z_strm, *z_images;
+	zend_fcall_info fci = empty_fcall_info;
+	zend_fcall_info_cache fci_cache = empty_fcall_info_cache;
+	long count = -1;
+	av_stream *strm;
+	gdImagePtr image;
+	double time;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz|f!l", &z_strm, &z_images, &fci, &fci_cache, &count) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_VIDEO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a video stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
+		return;
+	}
+
+	if(Z_TYPE_P(z_images) == IS_ARRAY) {
+		// fill each image in the array
+		HashTable *ht = Z_ARRVAL_P(z_images);
+		Bucket *p;
+
+		array_init(return_value);
+		for(p = ht->pListHead; p && count != 0; p = p->pListNext, count--) {
+			zval **p_element = p->pData;
+			image = (gdImagePtr) zend_fetch_resource(p_element TSRMLS_CC, -1, "image", NULL, 1, le_gd);
+			if(!image || !av_decode_image_to_gd(strm, image, &time TSRMLS_CC)) {
+				break;
+			}
+			add_next_index_double(return_value, time);
+		}
+	} else if(Z_TYPE_P(z_images) == IS_RESOURCE) {
+		// decode into the same image, invoking the callback after each frame
+		ZEND_FETCH_RESOURCE(image, gdImagePtr, &z_images, -1, "image", le_gd);
+		if(!ZEND_FCI_INITIALIZED(fci) && count < 0) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "A callback or a count is required when a single image is given");
+			return;
+		}
+
+		array_init(return_value);
+		while(count != 0) {
+			if(!av_decode_image_to_gd(strm, image, &time TSRMLS_CC)) {
+				break;
+			}
+			add_next_index_double(return_value, time);
+			if(count > 0) {
+				count--;
+			}
+			if(ZEND_FCI_INITIALIZED(fci)) {
+				zval *z_time, *z_retval = NULL;
+				zval **params[2];
+				int result, proceed = TRUE;
+
+				MAKE_STD_ZVAL(z_time);
+				ZVAL_DOUBLE(z_time, time);
+				params[0] = &z_images;
+				params[1] = &z_time;
+				fci.params = params;
+				fci.param_count = 2;
+				fci.retval_ptr_ptr = &z_retval;
+				result = zend_call_function(&fci, &fci_cache TSRMLS_CC);
+				zval_ptr_dtor(&z_time);
+				if(z_retval) {
+					// stop when the callback returns false
+					if(Z_TYPE_P(z_retval) == IS_BOOL && !Z_BVAL_P(z_retval)) {
+						proceed = FALSE;
+					}
+					zval_ptr_dtor(&z_retval);
+				}
+				if(result == FAILURE || EG(exception) || !proceed) {
+					break;
+				}
+			}
+		}
+	} else {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Parameter 2 should be an image or an array of images");
+		return;
+	}
+}
+/* }}} */
+
+/* {{{ proto array av_stream_read_frame(resource stream [, array options])
+   Read a frame as binary planes, optionally converted to a different pixel format or size */
+PHP_FUNCTION(av_stream_read_frame)
+{
+	zval *z_strm, *z_options = NULL;
+	av_stream *strm;
+	enum AVPixelFormat pix_fmt;
+	long width, height;
+	char *pixel_format_name = NULL;
+	double time;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|a", &z_strm, &z_options) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_VIDEO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a video stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
+		return;
+	}
+
+	// the frame is returned as decoded unless a different format or size is asked for
+	pix_fmt = strm->codec_cxt->pix_fmt;
+	width = strm->codec_cxt->width;
+	height = strm->codec_cxt->height;
+	if(av_get_element_string(z_options, "pix_fmt", &pixel_format_name)) {
+		pix_fmt = av_get_pix_fmt(pixel_format_name);
+		if(pix_fmt == AV_PIX_FMT_NONE) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid pixel format '%s'", pixel_format_name);
+			return;
+		}
+		if(pix_fmt != strm->codec_cxt->pix_fmt && !sws_isSupportedOutput(pix_fmt)) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Cannot convert to pixel format '%s'", pixel_format_name);
+			return;
+		}
+	}
+	av_get_element_long(z_options, "width", &width);
+	av_get_element_long(z_options, "height", &height);
+	if(width <= 0 || height <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid dimensions: %ldx%ld", width, height);
+		return;
+	}
+
+	if(av_decode_next_frame(strm, &time TSRMLS_CC)) {
+		array_init(return_value);
+		av_set_element_string(return_value, "pix_fmt", av_get_pix_fmt_name(pix_fmt));
+		av_set_element_long(return_value, "width", width);
+		av_set_element_long(return_value, "height", height);
+		av_set_element_double(return_value, "time", time);
+		av_set_element_long(return_value, "key_frame", strm->frame->key_frame);
+		if(strm->shared_memory_name) {
+			if(!av_write_frame_to_shared_memory(strm, return_value, pix_fmt, width, height TSRMLS_CC)) {
+				zval_dtor(return_value);
+				RETURN_FALSE;
+			}
+		} else if(pix_fmt == strm->codec_cxt->pix_fmt && width == strm->codec_cxt->width && height == strm->codec_cxt->height) {
+			av_copy_planes_to_zval(return_value, strm->frame->data, strm->frame->linesize, pix_fmt, width, height);
+		} else {
+			AVPicture picture;
+			if(avpicture_alloc(&picture, pix_fmt, width, height) < 0) {
+				zval_dtor(return_value);
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate picture");
+				RETURN_FALSE;
+			}
+			av_create_scaler(strm, width, height, pix_fmt, FOR_DECODING);
+			av_scale_picture(strm, (const uint8_t * const *) strm->frame->data, strm->frame->linesize, picture.data, picture.linesize);
+			av_copy_planes_to_zval(return_value, picture.data, picture.linesize, pix_fmt, width, height);
+			avpicture_free(&picture);
+		}
+	} else {
+		RETVAL_FALSE;
+	}
+}
+/* }}} */
+
 /* {{{ proto string av_stream_read_pcm()
    Read audio data */
 PHP_FUNCTION(av_stream_read_pcm)
 {
-	zval *z_strm, *z_buffer, *z_time = NULL;
+	zval *z_strm, *z_buffer, *z_time = NULL, *z_options = NULL;
 	av_stream *strm;
 	double time;
+	double min_duration = 0;
+	long min_samples = 0;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz|z", &z_strm, &z_buffer, &z_time) == FAILURE) {
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz|za", &z_strm, &z_buffer, &z_time, &z_options) == FAILURE) {
 		return;
 	}
 	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
@@ -2775,7 +4306,17 @@ PHP_FUNCTION(av_stream_read_pcm)
 		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
 		return;
 	}
-	if(av_decode_pcm_to_zval(strm, z_buffer, &time TSRMLS_CC)) {
+	if(z_options) {
+		// gather several frames into one buffer
+		av_get_element_double(z_options, "min_duration", &min_duration);
+		av_get_element_long(z_options, "min_samples", &min_samples);
+		if(min_samples < 0) {
+			min_samples = 0;
+		} else if(min_samples > INT_MAX) {
+			min_samples = INT_MAX;
+		}
+	}
+	if(av_decode_pcm_to_zval(strm, z_buffer, &time, (uint32_t) min_samples, min_duration TSRMLS_CC)) {
 		if(z_time) {
 			zval_dtor(z_time);
 			ZVAL_DOUBLE(z_time, time);
@@ -2787,6 +4328,345 @@ PHP_FUNCTION(av_stream_read_pcm)
 }
 /* }}} */
 
+static int av_use_float_pcm(av_stream *strm, int32_t sample_rate, int32_t channels TSRMLS_DC) {
+	// a sample rate or channel count of 0 means the codec's own
+	if(!strm->samples) {
+		strm->pcm_sample_fmt = AV_SAMPLE_FMT_FLT;
+		strm->pcm_sample_rate = sample_rate;
+		strm->pcm_channels = channels;
+		strm->pcm_channel_layout = (channels > 0) ? av_get_default_channel_layout(channels) : 0;
+	} else if(strm->pcm_sample_fmt != AV_SAMPLE_FMT_FLT || (sample_rate && strm->pcm_sample_rate != sample_rate) || (channels && strm->pcm_channels != channels)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Audio cannot be analyzed after PCM data in a different format has been read");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* {{{ proto array av_stream_analyze_audio()
+   Measure the loudness and levels of an audio stream */
+PHP_FUNCTION(av_stream_analyze_audio)
+{
+	zval *z_strm, *z_options = NULL;
+	av_stream *strm;
+	av_loudness_meter *meter = NULL;
+	double time, window_duration = AV_LOUDNESS_DEFAULT_WINDOW;
+	long true_peak = TRUE;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|a", &z_strm, &z_options) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_AUDIO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not an audio stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
+		return;
+	}
+	av_get_element_double(z_options, "window_duration", &window_duration);
+	av_get_element_long(z_options, "true_peak", &true_peak);
+
+	if(!av_use_float_pcm(strm, 0, 0 TSRMLS_CC)) {
+		return;
+	}
+
+	while(av_decode_next_frame(strm, &time TSRMLS_CC)) {
+		av_create_audio_buffer_and_resampler(strm, FOR_DECODING);
+		if(!meter) {
+			if(strm->pcm_channels > AV_PCM_MAX_CHANNELS) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "Audio with more than %d channels cannot be analyzed", AV_PCM_MAX_CHANNELS);
+				return;
+			}
+			meter = av_create_loudness_meter(strm->pcm_channels, strm->pcm_sample_rate, strm->pcm_channel_layout, window_duration, time, true_peak);
+		}
+		av_transfer_pcm_from_frame(strm);
+		av_add_loudness_samples(meter, (const float *) strm->samples, strm->sample_count);
+	}
+	if(meter) {
+		av_get_loudness_results(meter, return_value);
+		av_free_loudness_meter(meter);
+	} else {
+		RETVAL_FALSE;
+	}
+}
+/* }}} */
+
+/* {{{ proto array av_stream_waveform(resource stream, int buckets [, array options])
+   Reduce an audio stream to min/max peaks */
+PHP_FUNCTION(av_stream_waveform)
+{
+	zval *z_strm, *z_options = NULL;
+	av_stream *strm;
+	av_waveform *waveform = NULL;
+	long bucket_count, rms = FALSE, binary = FALSE;
+	double time, duration = 0, sample_duration = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl|a", &z_strm, &bucket_count, &z_options) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_AUDIO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not an audio stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
+		return;
+	}
+	if(bucket_count <= 0 || bucket_count > AV_WAVEFORM_MAX_BUCKETS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "The number of buckets must be between 1 and %d", AV_WAVEFORM_MAX_BUCKETS);
+		return;
+	}
+	av_get_element_long(z_options, "rms", &rms);
+	av_get_element_long(z_options, "binary", &binary);
+	av_get_element_double(z_options, "sample_duration", &sample_duration);
+
+	if(strm->stream->duration != AV_NOPTS_VALUE) {
+		duration = strm->stream->duration * av_q2d(strm->stream->time_base);
+	} else if(strm->file->format_cxt->duration != AV_NOPTS_VALUE) {
+		duration = (double) strm->file->format_cxt->duration / AV_TIME_BASE;
+	}
+	if(duration <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to determine the duration of the stream");
+		return;
+	}
+	if(!av_use_float_pcm(strm, 0, 0 TSRMLS_CC)) {
+		return;
+	}
+
+	if(sample_duration > 0 && sample_duration * bucket_count < duration) {
+		// seek to each bucket and decode only part of it
+		double bucket_duration = duration / bucket_count;
+		long i;
+		for(i = 0; i < bucket_count; i++) {
+			uint32_t sample_count = 0;
+			if(!av_seek_file(strm->file, bucket_duration * i, FALSE)) {
+				break;
+			}
+			if(waveform) {
+				av_set_waveform_bucket(waveform, i);
+			}
+			while(av_decode_next_frame(strm, &time TSRMLS_CC)) {
+				av_create_audio_buffer_and_resampler(strm, FOR_DECODING);
+				if(!waveform) {
+					// the channel count is only known once the first frame is decoded
+					waveform = av_create_waveform(strm->pcm_channels, bucket_count, (uint32_t) ceil(bucket_duration * strm->pcm_sample_rate), rms);
+					av_set_waveform_bucket(waveform, i);
+				}
+				av_transfer_pcm_from_frame(strm);
+				av_add_waveform_samples(waveform, (const float *) strm->samples, strm->sample_count);
+				sample_count += strm->sample_count;
+				if(sample_count >= sample_duration * strm->pcm_sample_rate) {
+					break;
+				}
+			}
+		}
+	} else {
+		while(av_decode_next_frame(strm, &time TSRMLS_CC)) {
+			av_create_audio_buffer_and_resampler(strm, FOR_DECODING);
+			if(!waveform) {
+				waveform = av_create_waveform(strm->pcm_channels, bucket_count, (uint32_t) ceil(duration * strm->pcm_sample_rate / bucket_count), rms);
+			}
+			av_transfer_pcm_from_frame(strm);
+			av_add_waveform_samples(waveform, (const float *) strm->samples, strm->sample_count);
+		}
+	}
+	if(waveform) {
+		av_get_waveform_results(waveform, return_value, binary);
+		av_free_waveform(waveform);
+	} else {
+		RETVAL_FALSE;
+	}
+}
+/* }}} */
+
+/* {{{ proto array av_stream_fingerprint(resource stream [, array options])
+   Compute an acoustic fingerprint of an audio stream */
+PHP_FUNCTION(av_stream_fingerprint)
+{
+	zval *z_strm, *z_options = NULL;
+	av_stream *strm;
+	av_fingerprinter *fp;
+	long binary = FALSE;
+	double time, duration = 0;
+	uint64_t sample_limit;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|a", &z_strm, &z_options) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_AUDIO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not an audio stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
+		return;
+	}
+	av_get_element_long(z_options, "binary", &binary);
+	av_get_element_double(z_options, "duration", &duration);
+	sample_limit = (duration > 0) ? (uint64_t) (duration * AV_FINGERPRINT_SAMPLE_RATE) : UINT64_MAX;
+
+	// let the resampler downmix to mono and bring the rate down
+	if(!av_use_float_pcm(strm, AV_FINGERPRINT_SAMPLE_RATE, 1 TSRMLS_CC)) {
+		return;
+	}
+
+	fp = av_create_fingerprinter();
+	if(!fp) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to set up the FFT for fingerprinting");
+		return;
+	}
+	while(fp->sample_count < sample_limit && av_decode_next_frame(strm, &time TSRMLS_CC)) {
+		uint32_t count;
+		av_create_audio_buffer_and_resampler(strm, FOR_DECODING);
+		av_transfer_pcm_from_frame(strm);
+		count = strm->sample_count;
+		if(fp->sample_count + count > sample_limit) {
+			count = (uint32_t) (sample_limit - fp->sample_count);
+		}
+		av_add_fingerprint_samples(fp, (const float *) strm->samples, count);
+	}
+	av_get_fingerprint_results(fp, return_value, binary);
+	av_free_fingerprinter(fp);
+}
+/* }}} */
+
+/* {{{ proto array av_stream_hash_frames(resource stream [, array options])
+   Compute perceptual hashes of video frames */
+PHP_FUNCTION(av_stream_hash_frames)
+{
+	zval *z_strm, *z_options = NULL;
+	av_stream *strm;
+	char *algorithm = NULL;
+	long interval = 1, count = 0;
+	int use_phash = FALSE;
+	uint32_t frame_index = 0;
+	double time;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|a", &z_strm, &z_options) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_VIDEO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a video stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
+		return;
+	}
+	if(av_get_element_string(z_options, "algorithm", &algorithm)) {
+		if(strcmp(algorithm, "phash") == 0) {
+			use_phash = TRUE;
+		} else if(strcmp(algorithm, "dhash") != 0) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a recognized hashing algorithm", algorithm);
+			return;
+		}
+	}
+	av_get_element_long(z_options, "interval", &interval);
+	av_get_element_long(z_options, "count", &count);
+	if(interval < 1) {
+		interval = 1;
+	}
+
+	array_init(return_value);
+	while((count <= 0 || zend_hash_num_elements(Z_ARRVAL_P(return_value)) < (uint32_t) count) && av_decode_next_frame(strm, &time TSRMLS_CC)) {
+		if(frame_index++ % interval == 0) {
+			uint8_t grid[AV_HASH_GRID_MAX_SIZE * AV_HASH_GRID_MAX_SIZE];
+			uint64_t hash;
+			char hex[17];
+			zval *z_entry;
+
+			if(use_phash) {
+				av_reduce_frame_to_grid(strm, grid, 32, 32);
+				hash = av_compute_phash(grid);
+			} else {
+				av_reduce_frame_to_grid(strm, grid, 9, 8);
+				hash = av_compute_dhash(grid);
+			}
+			// PHP integers might only be 32-bit, so the hash is given in hex
+			snprintf(hex, sizeof(hex), "%08x%08x", (uint32_t) (hash >> 32), (uint32_t) hash);
+
+			MAKE_STD_ZVAL(z_entry);
+			array_init(z_entry);
+			av_set_element_double(z_entry, "time", time);
+			av_set_element_string(z_entry, "hash", hex);
+			add_next_index_zval(return_value, z_entry);
+		}
+	}
+}
+/* }}} */
+
+/* {{{ proto array av_stream_read_frame_info(resource stream [, array options])
+   Read picture type, quantizer, packet size and motion statistics of decoded frames without converting them */
+PHP_FUNCTION(av_stream_read_frame_info)
+{
+	zval *z_strm, *z_options = NULL;
+	av_stream *strm;
+	long count = 0;
+	double time;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|a", &z_strm, &z_options) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(strm, av_stream *, &z_strm, -1, "av stream", le_av_strm);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(strm->codec->type != AVMEDIA_TYPE_VIDEO) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a video stream");
+		return;
+	}
+	if(!(strm->file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable stream");
+		return;
+	}
+	av_get_element_long(z_options, "count", &count);
+
+	array_init(return_value);
+	while((count <= 0 || zend_hash_num_elements(Z_ARRVAL_P(return_value)) < (uint32_t) count) && av_decode_next_frame(strm, &time TSRMLS_CC)) {
+		AVFrame *frame = strm->frame;
+		char type[2];
+		double qp, magnitude;
+		long vector_count;
+		zval *z_entry;
+
+		type[0] = av_get_picture_type_char(frame->pict_type);
+		type[1] = '\0';
+
+		MAKE_STD_ZVAL(z_entry);
+		array_init(z_entry);
+		av_set_element_double(z_entry, "time", time);
+		av_set_element_string(z_entry, "type", type);
+		av_set_element_long(z_entry, "key_frame", frame->key_frame);
+		av_set_element_long(z_entry, "size", av_frame_get_pkt_size(frame));
+		// the remaining items are only there when the decoder exports them
+		if(av_compute_mean_qp(frame, strm->codec_cxt->width, strm->codec_cxt->height, &qp)) {
+			av_set_element_double(z_entry, "qp", qp);
+		}
+		if((strm->flags & AV_STREAM_EXPORTING_MOTION_VECTORS) && av_summarize_motion_vectors(frame, &magnitude, &vector_count)) {
+			av_set_element_double(z_entry, "motion", magnitude);
+			av_set_element_long(z_entry, "motion_vectors", vector_count);
+		}
+		add_next_index_zval(return_value, z_entry);
+	}
+}
+/* }}} */
+
 /* {{{ proto string av_stream_read_subtitle()
    Read an image */
 PHP_FUNCTION(av_stream_read_subtitle)
@@ -2822,6 +4702,155 @@ PHP_FUNCTION(av_stream_read_subtitle)
 }
 /* }}} */
 
+/* {{{ proto array av_file_extract_thumbnails(resource file, int count, int width, int height [, array options])
+   Extract evenly-spaced images from the video stream opened in a file */
+PHP_FUNCTION(av_file_extract_thumbnails)
+{
+	zval *z_file, *z_options = NULL;
+	zval *z_images = NULL, *z_sprite = NULL, *z_times, *z_timings;
+	av_file *file;
+	av_stream *strm;
+	long count, width, height;
+	long columns = 0, precise = FALSE;
+	double start_time = 0, end_time = 0, interval = 0;
+	double frame_time = 0;
+	int have_frame = FALSE, key_frame_index = -1;
+	gdImagePtr sprite = NULL;
+	gdImage cell;
+	long i;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rlll|a", &z_file, &count, &width, &height, &z_options) == FAILURE) {
+		return;
+	}
+	ZEND_FETCH_RESOURCE(file, av_file *, &z_file, -1, "av file", le_av_file);
+
+	av_set_log_level(TSRMLS_C);
+
+	if(!(file->flags & AV_FILE_READ)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Not a readable file");
+		return;
+	}
+	strm = av_find_open_video_stream(file);
+	if(!strm) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "No video stream is open");
+		return;
+	}
+	if(width <= 0 || height <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Invalid dimensions: %ldx%ld", width, height);
+		return;
+	}
+
+	if(file->format_cxt->duration != AV_NOPTS_VALUE) {
+		end_time = (double) file->format_cxt->duration / AV_TIME_BASE;
+	}
+	av_get_element_double(z_options, "start", &start_time);
+	av_get_element_double(z_options, "end", &end_time);
+	av_get_element_long(z_options, "precise", &precise);
+	av_get_element_long(z_options, "sprite", &columns);
+	if(av_get_element_double(z_options, "interval", &interval) && interval > 0) {
+		count = (long) ceil((end_time - start_time) / interval);
+	} else if(count > 0) {
+		interval = (end_time - start_time) / count;
+	}
+	if(count <= 0 || !(end_time > start_time)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to determine the times of the images");
+		return;
+	}
+
+	array_init(return_value);
+	MAKE_STD_ZVAL(z_times);
+	array_init(z_times);
+	MAKE_STD_ZVAL(z_timings);
+	array_init(z_timings);
+	if(columns > 0) {
+		// place the images in a grid on a single image
+		long rows = (count + columns - 1) / columns;
+		z_sprite = av_create_gd_truecolor_image(width * ((count < columns) ? count : columns), height * rows TSRMLS_CC);
+		if(z_sprite) {
+			sprite = (gdImagePtr) zend_fetch_resource(&z_sprite TSRMLS_CC, -1, "image", NULL, 1, le_gd);
+		}
+		if(!sprite) {
+			zval_ptr_dtor(&z_times);
+			zval_ptr_dtor(&z_timings);
+			if(z_sprite) {
+				zval_ptr_dtor(&z_sprite);
+			}
+			zval_dtor(return_value);
+			RETURN_FALSE;
+		}
+		memset(&cell, 0, sizeof(cell));
+		cell.trueColor = TRUE;
+		cell.sx = width;
+		cell.sy = height;
+		cell.tpixels = emalloc(sizeof(int *) * height);
+	} else {
+		MAKE_STD_ZVAL(z_images);
+		array_init(z_images);
+	}
+
+	for(i = 0; i < count; i++) {
+		// take the image from the middle of each interval
+		double time_sought = start_time + interval * i + interval * 0.5;
+		int64_t clock_start = av_gettime();
+		int index = av_get_key_frame_index(strm, time_sought);
+		gdImagePtr image = NULL;
+		zval *z_image = NULL;
+		int decoded;
+
+		if(have_frame && index >= 0 && index == key_frame_index && frame_time <= time_sought) {
+			// the time sought is in the GOP already being decoded
+			if(precise) {
+				decoded = av_roll_forward(strm, time_sought, &frame_time TSRMLS_CC);
+			} else {
+				// the key frame is still in strm->frame
+				decoded = TRUE;
+			}
+		} else {
+			decoded = av_seek_file(file, time_sought, precise) && av_decode_next_frame(strm, &frame_time TSRMLS_CC);
+			key_frame_index = (decoded) ? av_get_key_frame_index(strm, frame_time) : -1;
+		}
+		if(!decoded) {
+			break;
+		}
+		have_frame = TRUE;
+
+		if(sprite) {
+			long x = (i % columns) * width, y = (i / columns) * height, r;
+			for(r = 0; r < height; r++) {
+				cell.tpixels[r] = sprite->tpixels[y + r] + x;
+			}
+			image = &cell;
+		} else {
+			z_image = av_create_gd_truecolor_image(width, height TSRMLS_CC);
+			if(z_image) {
+				image = (gdImagePtr) zend_fetch_resource(&z_image TSRMLS_CC, -1, "image", NULL, 1, le_gd);
+			}
+			if(!image) {
+				if(z_image) {
+					zval_ptr_dtor(&z_image);
+				}
+				break;
+			}
+		}
+		av_convert_frame_to_gd(strm, image);
+		if(z_image) {
+			zend_hash_next_index_insert(Z_ARRVAL_P(z_images), &z_image, sizeof(zval *), NULL);
+		}
+		add_next_index_double(z_times, frame_time);
+		add_next_index_double(z_timings, (double) (av_gettime() - clock_start) / 1000000);
+	}
+
+	if(sprite) {
+		efree(cell.tpixels);
+		zend_hash_update(Z_ARRVAL_P(return_value), "sprite", sizeof("sprite"), (void *) &z_sprite, sizeof(zval *), NULL);
+	} else {
+		zend_hash_update(Z_ARRVAL_P(return_value), "images", sizeof("images"), (void *) &z_images, sizeof(zval *), NULL);
+	}
+	zend_hash_update(Z_ARRVAL_P(return_value), "times", sizeof("times"), (void *) &z_times, sizeof(zval *), NULL);
+	zend_hash_update(Z_ARRVAL_P(return_value), "timings", sizeof("timings"), (void *) &z_timings, sizeof(zval *), NULL);
+}
+/* }}} */
+
 /* {{{ proto string av_stream_close(resource res)
    Close an av stream */
 PHP_FUNCTION(av_stream_close)
@@ -0,0 +1,734 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "php.h"
+#include "php_av.h"
+
+// loudness measurement according to ITU-R BS.1770-4 and EBU Tech 3342
+
+#define AV_LOUDNESS_ABSOLUTE_GATE		-70.0
+#define AV_LOUDNESS_RELATIVE_GATE		-10.0
+#define AV_LOUDNESS_RANGE_GATE			-20.0
+#define AV_LOUDNESS_BLOCK_COUNT			4		// 400ms gating blocks
+#define AV_LOUDNESS_SHORT_TERM_COUNT	30		// 3s short-term blocks
+
+// polyphase filter for 4x oversampling (BS.1770-4, annex 2)
+static const float av_true_peak_coefficients[4][12] = {
+	{  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+	   0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+	{ -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+	   0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+	{ -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+	   0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+	{ -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+	   0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+
+static double av_energy_to_loudness(double energy) {
+	return (energy > 0) ? -0.691 + 10 * log10(energy) : -HUGE_VAL;
+}
+
+static double av_amplitude_to_decibels(double amplitude) {
+	return (amplitude > 0) ? 20 * log10(amplitude) : -HUGE_VAL;
+}
+
+static int av_compare_doubles(const void *p1, const void *p2) {
+	double d1 = *(const double *) p1, d2 = *(const double *) p2;
+	return (d1 < d2) ? -1 : (d1 > d2) ? 1 : 0;
+}
+
+av_loudness_meter *av_create_loudness_meter(uint32_t channels, uint32_t sample_rate, uint64_t channel_layout, double window_duration, double start_time, int true_peak) {
+	av_loudness_meter *meter = ecalloc(1, sizeof(av_loudness_meter));
+	double f0, q, k, vh, vb, a0;
+	uint32_t i;
+
+	meter->channels = channels;
+	meter->sample_rate = sample_rate;
+	for(i = 0; i < channels; i++) {
+		// LFE is left out; surround channels are boosted by 1.5dB
+		uint64_t channel = (channel_layout) ? av_channel_layout_extract_channel(channel_layout, i) : 0;
+		if(channel == AV_CH_LOW_FREQUENCY) {
+			meter->weights[i] = 0;
+		} else if(channel & (AV_CH_BACK_LEFT | AV_CH_BACK_RIGHT | AV_CH_SIDE_LEFT | AV_CH_SIDE_RIGHT)) {
+			meter->weights[i] = 1.41;
+		} else {
+			meter->weights[i] = 1.0;
+		}
+	}
+
+	// K-weighting: a high shelf followed by a high pass, with coefficients derived for the actual sample rate
+	f0 = 1681.974450955533;
+	q = 0.7071752369554196;
+	k = tan(M_PI * f0 / sample_rate);
+	vh = pow(10.0, 3.999843853973347 / 20.0);
+	vb = pow(vh, 0.4996667741545416);
+	a0 = 1.0 + k / q + k * k;
+	meter->shelf[0] = (vh + vb * k / q + k * k) / a0;
+	meter->shelf[1] = 2.0 * (k * k - vh) / a0;
+	meter->shelf[2] = (vh - vb * k / q + k * k) / a0;
+	meter->shelf[3] = 2.0 * (k * k - 1.0) / a0;
+	meter->shelf[4] = (1.0 - k / q + k * k) / a0;
+
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = tan(M_PI * f0 / sample_rate);
+	a0 = 1.0 + k / q + k * k;
+	meter->highpass[0] = 1.0;
+	meter->highpass[1] = -2.0;
+	meter->highpass[2] = 1.0;
+	meter->highpass[3] = 2.0 * (k * k - 1.0) / a0;
+	meter->highpass[4] = (1.0 - k / q + k * k) / a0;
+
+	meter->block_length = sample_rate / 10;
+	meter->block_capacity = 1024;
+	meter->block_energies = emalloc(sizeof(double) * meter->block_capacity);
+
+	// oversampling is pointless once the sample rate is high enough
+	meter->true_peak_enabled = true_peak && sample_rate < 96000;
+
+	if(window_duration > 0) {
+		MAKE_STD_ZVAL(meter->windows);
+		array_init(meter->windows);
+		meter->window_length = (uint32_t) ceil(window_duration * sample_rate);
+		meter->window_start_time = start_time;
+	}
+	return meter;
+}
+
+static void av_finish_loudness_window(av_loudness_meter *meter) {
+	zval *window;
+	MAKE_STD_ZVAL(window);
+	array_init(window);
+	av_set_element_double(window, "time", meter->window_start_time);
+	av_set_element_double(window, "peak", av_amplitude_to_decibels(meter->window_peak));
+	av_set_element_double(window, "rms", 10 * log10(meter->window_square_sum / (meter->window_position * meter->channels)));
+	av_set_element_double(window, "loudness", av_energy_to_loudness(meter->window_energy / meter->window_position));
+	add_next_index_zval(meter->windows, window);
+
+	meter->window_start_time += (double) meter->window_position / meter->sample_rate;
+	meter->window_position = 0;
+	meter->window_peak = 0;
+	meter->window_square_sum = 0;
+	meter->window_energy = 0;
+}
+
+void av_add_loudness_samples(av_loudness_meter *meter, const float *samples, uint32_t count) {
+	const double *s = meter->shelf, *h = meter->highpass;
+	uint32_t i, c;
+
+	for(i = 0; i < count; i++) {
+		double energy = 0, square_sum = 0, peak = 0;
+
+		for(c = 0; c < meter->channels; c++) {
+			double *state = meter->filter_state[c];
+			double x = samples[c], y, z, magnitude = fabs(x);
+
+			// transposed direct form II, one biquad after the other
+			y = s[0] * x + state[0];
+			state[0] = s[1] * x - s[3] * y + state[1];
+			state[1] = s[2] * x - s[4] * y;
+			z = h[0] * y + state[2];
+			state[2] = h[1] * y - h[3] * z + state[3];
+			state[3] = h[2] * y - h[4] * z;
+
+			energy += meter->weights[c] * z * z;
+			square_sum += x * x;
+			if(magnitude > peak) {
+				peak = magnitude;
+			}
+
+			if(meter->true_peak_enabled) {
+				float *history = meter->true_peak_history[c];
+				int p, t;
+				memmove(history, history + 1, sizeof(float) * 11);
+				history[11] = samples[c];
+				for(p = 0; p < 4; p++) {
+					const float *coefficients = av_true_peak_coefficients[p];
+					float interpolated = 0;
+					for(t = 0; t < 12; t++) {
+						interpolated += coefficients[t] * history[11 - t];
+					}
+					if(fabs(interpolated) > meter->true_peak) {
+						meter->true_peak = fabs(interpolated);
+					}
+				}
+			}
+		}
+		samples += meter->channels;
+
+		if(peak > meter->sample_peak) {
+			meter->sample_peak = peak;
+		}
+		meter->square_sum += square_sum;
+		meter->block_energy += energy;
+
+		if(++meter->block_position == meter->block_length) {
+			if(meter->block_count == meter->block_capacity) {
+				meter->block_capacity *= 2;
+				meter->block_energies = erealloc(meter->block_energies, sizeof(double) * meter->block_capacity);
+			}
+			meter->block_energies[meter->block_count++] = meter->block_energy / meter->block_length;
+			meter->block_energy = 0;
+			meter->block_position = 0;
+		}
+
+		if(meter->windows) {
+			meter->window_energy += energy;
+			meter->window_square_sum += square_sum;
+			if(peak > meter->window_peak) {
+				meter->window_peak = peak;
+			}
+			if(++meter->window_position == meter->window_length) {
+				av_finish_loudness_window(meter);
+			}
+		}
+	}
+	meter->sample_count += count;
+}
+
+static double av_get_gated_loudness(const double *energies, uint32_t count, double relative_gate) {
+	// average the blocks above the absolute threshold, then those above the relative one
+	double sum = 0, threshold;
+	uint32_t i, n = 0;
+	for(i = 0; i < count; i++) {
+		if(av_energy_to_loudness(energies[i]) > AV_LOUDNESS_ABSOLUTE_GATE) {
+			sum += energies[i];
+			n++;
+		}
+	}
+	if(n == 0) {
+		return -HUGE_VAL;
+	}
+	threshold = av_energy_to_loudness(sum / n) + relative_gate;
+	sum = 0;
+	n = 0;
+	for(i = 0; i < count; i++) {
+		double loudness = av_energy_to_loudness(energies[i]);
+		if(loudness > AV_LOUDNESS_ABSOLUTE_GATE && loudness > threshold) {
+			sum += energies[i];
+			n++;
+		}
+	}
+	return (n > 0) ? av_energy_to_loudness(sum / n) : -HUGE_VAL;
+}
+
+static double *av_get_overlapping_blocks(av_loudness_meter *meter, uint32_t length, uint32_t *p_count) {
+	// blocks of the given number of sub-blocks, advancing one sub-block at a time
+	double *energies, sum = 0;
+	uint32_t i, count;
+	if(meter->block_count < length) {
+		*p_count = 0;
+		return NULL;
+	}
+	count = meter->block_count - length + 1;
+	energies = emalloc(sizeof(double) * count);
+	for(i = 0; i < meter->block_count; i++) {
+		sum += meter->block_energies[i];
+		if(i >= length) {
+			sum -= meter->block_energies[i - length];
+		}
+		if(i + 1 >= length) {
+			energies[i + 1 - length] = sum / length;
+		}
+	}
+	*p_count = count;
+	return energies;
+}
+
+void av_get_loudness_results(av_loudness_meter *meter, zval *result) {
+	double *energies, integrated = -HUGE_VAL, range = 0;
+	uint32_t count;
+
+	if(meter->windows && meter->window_position > 0) {
+		av_finish_loudness_window(meter);
+	}
+
+	energies = av_get_overlapping_blocks(meter, AV_LOUDNESS_BLOCK_COUNT, &count);
+	if(energies) {
+		integrated = av_get_gated_loudness(energies, count, AV_LOUDNESS_RELATIVE_GATE);
+		efree(energies);
+	}
+
+	energies = av_get_overlapping_blocks(meter, AV_LOUDNESS_SHORT_TERM_COUNT, &count);
+	if(energies) {
+		// the spread between the 10th and 95th percentile of the gated short-term loudness
+		double sum = 0, threshold;
+		uint32_t i, n = 0;
+		for(i = 0; i < count; i++) {
+			if(av_energy_to_loudness(energies[i]) > AV_LOUDNESS_ABSOLUTE_GATE) {
+				sum += energies[i];
+				n++;
+			}
+		}
+		if(n > 0) {
+			threshold = av_energy_to_loudness(sum / n) + AV_LOUDNESS_RANGE_GATE;
+			n = 0;
+			for(i = 0; i < count; i++) {
+				double loudness = av_energy_to_loudness(energies[i]);
+				if(loudness > AV_LOUDNESS_ABSOLUTE_GATE && loudness > threshold) {
+					energies[n++] = loudness;
+				}
+			}
+			if(n > 0) {
+				qsort(energies, n, sizeof(double), av_compare_doubles);
+				range = energies[(uint32_t) floor((n - 1) * 0.95 + 0.5)] - energies[(uint32_t) floor((n - 1) * 0.10 + 0.5)];
+			}
+		}
+		efree(energies);
+	}
+
+	array_init(result);
+	av_set_element_double(result, "duration", (double) meter->sample_count / meter->sample_rate);
+	av_set_element_double(result, "integrated_loudness", integrated);
+	av_set_element_double(result, "loudness_range", range);
+	av_set_element_double(result, "sample_peak", av_amplitude_to_decibels(meter->sample_peak));
+	av_set_element_double(result, "true_peak", av_amplitude_to_decibels((meter->true_peak > meter->sample_peak) ? meter->true_peak : meter->sample_peak));
+	av_set_element_double(result, "rms", (meter->sample_count > 0) ? 10 * log10(meter->square_sum / (meter->sample_count * meter->channels)) : -HUGE_VAL);
+	if(meter->windows) {
+		zend_hash_update(Z_ARRVAL_P(result), "windows", sizeof("windows"), (void *) &meter->windows, sizeof(zval *), NULL);
+		meter->windows = NULL;
+	}
+}
+
+void av_free_loudness_meter(av_loudness_meter *meter) {
+	if(meter->windows) {
+		zval_ptr_dtor(&meter->windows);
+	}
+	efree(meter->block_energies);
+	efree(meter);
+}
+
+av_waveform *av_create_waveform(uint32_t channels, uint32_t bucket_count, uint32_t samples_per_bucket, int rms) {
+	av_waveform *waveform = ecalloc(1, sizeof(av_waveform));
+	uint32_t i;
+
+	waveform->channels = channels;
+	waveform->bucket_count = bucket_count;
+	waveform->samples_per_bucket = (samples_per_bucket > 0) ? samples_per_bucket : 1;
+	waveform->mins = safe_emalloc(bucket_count, sizeof(float) * channels, 0);
+	waveform->maxs = safe_emalloc(bucket_count, sizeof(float) * channels, 0);
+	for(i = 0; i < bucket_count * channels; i++) {
+		waveform->mins[i] = HUGE_VAL;
+		waveform->maxs[i] = -HUGE_VAL;
+	}
+	if(rms) {
+		waveform->square_sums = ecalloc(bucket_count, sizeof(double) * channels);
+	}
+	waveform->sample_counts = ecalloc(bucket_count, sizeof(uint32_t));
+	return waveform;
+}
+
+void av_add_waveform_samples(av_waveform *waveform, const float *samples, uint32_t count) {
+	// split the samples at bucket boundaries; the last bucket takes whatever is left over
+	while(count > 0 && waveform->bucket_index < waveform->bucket_count) {
+		uint32_t index = waveform->bucket_index;
+		uint32_t n = count;
+		if(index < waveform->bucket_count - 1 && n > waveform->samples_per_bucket - waveform->bucket_position) {
+			n = waveform->samples_per_bucket - waveform->bucket_position;
+		}
+		av_accumulate_range(samples, waveform->channels, n, waveform->mins + index * waveform->channels, waveform->maxs + index * waveform->channels,
+							(waveform->square_sums) ? waveform->square_sums + index * waveform->channels : NULL);
+		waveform->sample_counts[index] += n;
+		waveform->bucket_position += n;
+		samples += n * waveform->channels;
+		count -= n;
+		if(waveform->bucket_position >= waveform->samples_per_bucket && index < waveform->bucket_count - 1) {
+			waveform->bucket_index++;
+			waveform->bucket_position = 0;
+		}
+	}
+}
+
+void av_set_waveform_bucket(av_waveform *waveform, uint32_t index) {
+	waveform->bucket_index = index;
+	waveform->bucket_position = 0;
+}
+
+static zval *av_create_waveform_values(av_waveform *waveform, const float *values, const double *square_sums, int binary) {
+	zval *z_values;
+	uint32_t i, c, count = waveform->bucket_count * waveform->channels;
+
+	MAKE_STD_ZVAL(z_values);
+	if(binary) {
+		// floats, with the channels interleaved as in PCM data
+		float *data = emalloc(sizeof(float) * count + 1);
+		for(i = 0; i < count; i++) {
+			uint32_t sample_count = waveform->sample_counts[i / waveform->channels];
+			if(sample_count == 0) {
+				data[i] = 0;
+			} else if(square_sums) {
+				data[i] = (float) sqrt(square_sums[i] / sample_count);
+			} else {
+				data[i] = values[i];
+			}
+		}
+		((char *) data)[sizeof(float) * count] = '\0';
+		ZVAL_STRINGL(z_values, (char *) data, sizeof(float) * count, 0);
+	} else {
+		// one array per channel
+		array_init(z_values);
+		for(c = 0; c < waveform->channels; c++) {
+			zval *z_channel;
+			MAKE_STD_ZVAL(z_channel);
+			array_init_size(z_channel, waveform->bucket_count);
+			for(i = 0; i < waveform->bucket_count; i++) {
+				uint32_t sample_count = waveform->sample_counts[i];
+				uint32_t index = i * waveform->channels + c;
+				if(sample_count == 0) {
+					add_next_index_double(z_channel, 0);
+				} else if(square_sums) {
+					add_next_index_double(z_channel, sqrt(square_sums[index] / sample_count));
+				} else {
+					add_next_index_double(z_channel, values[index]);
+				}
+			}
+			add_next_index_zval(z_values, z_channel);
+		}
+	}
+	return z_values;
+}
+
+void av_get_waveform_results(av_waveform *waveform, zval *result, int binary) {
+	zval *z_mins = av_create_waveform_values(waveform, waveform->mins, NULL, binary);
+	zval *z_maxs = av_create_waveform_values(waveform, waveform->maxs, NULL, binary);
+
+	array_init(result);
+	av_set_element_long(result, "channels", waveform->channels);
+	av_set_element_long(result, "buckets", waveform->bucket_count);
+	av_set_element_long(result, "samples_per_bucket", waveform->samples_per_bucket);
+	zend_hash_update(Z_ARRVAL_P(result), "min", sizeof("min"), (void *) &z_mins, sizeof(zval *), NULL);
+	zend_hash_update(Z_ARRVAL_P(result), "max", sizeof("max"), (void *) &z_maxs, sizeof(zval *), NULL);
+	if(waveform->square_sums) {
+		zval *z_rms = av_create_waveform_values(waveform, NULL, waveform->square_sums, binary);
+		zend_hash_update(Z_ARRVAL_P(result), "rms", sizeof("rms"), (void *) &z_rms, sizeof(zval *), NULL);
+	}
+}
+
+void av_free_waveform(av_waveform *waveform) {
+	efree(waveform->mins);
+	efree(waveform->maxs);
+	if(waveform->square_sums) {
+		efree(waveform->square_sums);
+	}
+	efree(waveform->sample_counts);
+	efree(waveform);
+}
+
+// The fingerprint follows the outline of Chromaprint without being bit-compatible with it: the audio is
+// split into frames of 4096 samples at 11025Hz, overlapping by two thirds; each frame's spectrum is folded
+// into 12 pitch classes between 28Hz and 3520Hz; the chroma vectors are smoothed over five frames and
+// normalized. Each vector then yields a 32-bit code:
+//
+//   bits 0-11    the change in the difference between neighbouring pitch classes since the last frame
+//   bits 12-23   whether each pitch class got stronger since the last frame
+//   bits 24-31   whether each of the first eight pitch classes is stronger than the one a major third above
+//
+// Two recordings of the same audio give codes with a small Hamming distance.
+
+#define AV_FINGERPRINT_MIN_FREQUENCY	28.0
+#define AV_FINGERPRINT_MAX_FREQUENCY	3520.0
+
+static const double av_chroma_filter[5] = { 0.25, 0.75, 1.0, 0.75, 0.25 };
+
+av_fingerprinter *av_create_fingerprinter(void) {
+	av_fingerprinter *fp = ecalloc(1, sizeof(av_fingerprinter));
+	uint32_t i;
+
+	fp->rdft = av_rdft_init(AV_FINGERPRINT_FRAME_BITS, DFT_R2C);
+	if(!fp->rdft) {
+		efree(fp);
+		return NULL;
+	}
+	fp->window = emalloc(sizeof(float) * AV_FINGERPRINT_FRAME_SIZE);
+	fp->frame = emalloc(sizeof(float) * AV_FINGERPRINT_FRAME_SIZE);
+	fp->spectrum = av_malloc(sizeof(float) * AV_FINGERPRINT_FRAME_SIZE);
+	for(i = 0; i < AV_FINGERPRINT_FRAME_SIZE; i++) {
+		// Hamming window
+		fp->window[i] = (float) (0.54 - 0.46 * cos(2 * M_PI * i / (AV_FINGERPRINT_FRAME_SIZE - 1)));
+	}
+	fp->code_capacity = 256;
+	fp->codes = emalloc(sizeof(uint32_t) * fp->code_capacity);
+	return fp;
+}
+
+static void av_add_fingerprint_chroma(av_fingerprinter *fp, const double *chroma) {
+	double smoothed[12], norm = 0;
+	uint32_t code = 0;
+	int i, k;
+
+	memmove(fp->chroma_history[0], fp->chroma_history[1], sizeof(fp->chroma_history[0]) * 4);
+	memcpy(fp->chroma_history[4], chroma, sizeof(fp->chroma_history[4]));
+	if(++fp->chroma_count < 5) {
+		return;
+	}
+	for(k = 0; k < 12; k++) {
+		smoothed[k] = 0;
+		for(i = 0; i < 5; i++) {
+			smoothed[k] += av_chroma_filter[i] * fp->chroma_history[i][k];
+		}
+		norm += smoothed[k] * smoothed[k];
+	}
+	norm = sqrt(norm);
+	for(k = 0; k < 12; k++) {
+		smoothed[k] = (norm >= 0.01) ? smoothed[k] / norm : 0;
+	}
+
+	if(fp->has_previous_chroma) {
+		const double *previous = fp->previous_chroma;
+		for(k = 0; k < 12; k++) {
+			int next = (k + 1) % 12;
+			if((smoothed[k] - smoothed[next]) - (previous[k] - previous[next]) > 0) {
+				code |= 1u << k;
+			}
+			if(smoothed[k] > previous[k]) {
+				code |= 1u << (12 + k);
+			}
+		}
+		for(k = 0; k < 8; k++) {
+			if(smoothed[k] > smoothed[(k + 4) % 12]) {
+				code |= 1u << (24 + k);
+			}
+		}
+		if(fp->code_count == fp->code_capacity) {
+			fp->code_capacity *= 2;
+			fp->codes = erealloc(fp->codes, sizeof(uint32_t) * fp->code_capacity);
+		}
+		fp->codes[fp->code_count++] = code;
+	}
+	memcpy(fp->previous_chroma, smoothed, sizeof(smoothed));
+	fp->has_previous_chroma = TRUE;
+}
+
+static void av_process_fingerprint_frame(av_fingerprinter *fp) {
+	double chroma[12] = { 0 };
+	uint32_t i;
+
+	for(i = 0; i < AV_FINGERPRINT_FRAME_SIZE; i++) {
+		fp->spectrum[i] = fp->frame[i] * fp->window[i];
+	}
+	av_rdft_calc(fp->rdft, fp->spectrum);
+
+	// bins come out as (re, im) pairs after the DC and Nyquist terms
+	for(i = 1; i < AV_FINGERPRINT_FRAME_SIZE / 2; i++) {
+		double frequency = (double) i * AV_FINGERPRINT_SAMPLE_RATE / AV_FINGERPRINT_FRAME_SIZE;
+		if(frequency >= AV_FINGERPRINT_MIN_FREQUENCY && frequency <= AV_FINGERPRINT_MAX_FREQUENCY) {
+			double re = fp->spectrum[i * 2], im = fp->spectrum[i * 2 + 1];
+			double octave = log(frequency / (440.0 / 16)) / log(2.0);
+			int note = (int) (12 * (octave - floor(octave)));
+			chroma[note % 12] += re * re + im * im;
+		}
+	}
+	av_add_fingerprint_chroma(fp, chroma);
+}
+
+void av_add_fingerprint_samples(av_fingerprinter *fp, const float *samples, uint32_t count) {
+	fp->sample_count += count;
+	while(count > 0) {
+		uint32_t n = AV_FINGERPRINT_FRAME_SIZE - fp->frame_fill;
+		if(n > count) {
+			n = count;
+		}
+		memcpy(fp->frame + fp->frame_fill, samples, sizeof(float) * n);
+		fp->frame_fill += n;
+		samples += n;
+		count -= n;
+		if(fp->frame_fill == AV_FINGERPRINT_FRAME_SIZE) {
+			av_process_fingerprint_frame(fp);
+			memmove(fp->frame, fp->frame + AV_FINGERPRINT_FRAME_STEP, sizeof(float) * (AV_FINGERPRINT_FRAME_SIZE - AV_FINGERPRINT_FRAME_STEP));
+			fp->frame_fill -= AV_FINGERPRINT_FRAME_STEP;
+		}
+	}
+}
+
+void av_get_fingerprint_results(av_fingerprinter *fp, zval *result, int binary) {
+	zval *z_codes;
+	uint32_t i;
+
+	MAKE_STD_ZVAL(z_codes);
+	if(binary) {
+		// little-endian 32-bit integers
+		char *data = emalloc(fp->code_count * 4 + 1);
+		for(i = 0; i < fp->code_count; i++) {
+			uint32_t code = fp->codes[i];
+			data[i * 4 + 0] = (char) (code & 0xFF);
+			data[i * 4 + 1] = (char) ((code >> 8) & 0xFF);
+			data[i * 4 + 2] = (char) ((code >> 16) & 0xFF);
+			data[i * 4 + 3] = (char) ((code >> 24) & 0xFF);
+		}
+		data[fp->code_count * 4] = '\0';
+		ZVAL_STRINGL(z_codes, data, fp->code_count * 4, 0);
+	} else {
+		// PHP integers might only be 32-bit, so each code is given in hex
+		array_init_size(z_codes, fp->code_count);
+		for(i = 0; i < fp->code_count; i++) {
+			char hex[9];
+			snprintf(hex, sizeof(hex), "%08x", fp->codes[i]);
+			add_next_index_stringl(z_codes, hex, 8, 1);
+		}
+	}
+	array_init(result);
+	av_set_element_double(result, "duration", (double) fp->sample_count / AV_FINGERPRINT_SAMPLE_RATE);
+	av_set_element_double(result, "code_duration", (double) AV_FINGERPRINT_FRAME_STEP / AV_FINGERPRINT_SAMPLE_RATE);
+	zend_hash_update(Z_ARRVAL_P(result), "codes", sizeof("codes"), (void *) &z_codes, sizeof(zval *), NULL);
+}
+
+void av_free_fingerprinter(av_fingerprinter *fp) {
+	av_rdft_end(fp->rdft);
+	av_free(fp->spectrum);
+	efree(fp->window);
+	efree(fp->frame);
+	efree(fp->codes);
+	efree(fp);
+}
+
+// perceptual hashes of video frames, computed from a small grayscale grid
+
+void av_reduce_luma_plane(const uint8_t *plane, int linesize, int width, int height, uint8_t *grid, int grid_width, int grid_height) {
+	// average the pixels falling into each cell of the grid
+	uint32_t sums[AV_HASH_GRID_MAX_SIZE * AV_HASH_GRID_MAX_SIZE] = { 0 };
+	uint32_t counts[AV_HASH_GRID_MAX_SIZE * AV_HASH_GRID_MAX_SIZE] = { 0 };
+	int column_cells[4096];
+	int x, y, i;
+
+	if(width > 4096) {
+		// only sample every step-th column of frames too wide for the column table
+		int step = (width + 4095) / 4096;
+		for(y = 0; y < height; y++) {
+			const uint8_t *row = plane + linesize * y;
+			int gy = y * grid_height / height;
+			for(x = 0; x < width; x += step) {
+				int cell = gy * grid_width + x * grid_width / width;
+				sums[cell] += row[x];
+				counts[cell]++;
+			}
+		}
+	} else {
+		for(x = 0; x < width; x++) {
+			column_cells[x] = x * grid_width / width;
+		}
+		for(y = 0; y < height; y++) {
+			const uint8_t *row = plane + linesize * y;
+			int cell_base = (y * grid_height / height) * grid_width;
+			for(x = 0; x < width; x++) {
+				int cell = cell_base + column_cells[x];
+				sums[cell] += row[x];
+				counts[cell]++;
+			}
+		}
+	}
+	for(i = 0; i < grid_width * grid_height; i++) {
+		grid[i] = (counts[i] > 0) ? (uint8_t) (sums[i] / counts[i]) : 0;
+	}
+}
+
+uint64_t av_compute_dhash(const uint8_t *grid) {
+	// 9x8 grid: one bit per horizontally adjacent pair, set when brightness increases
+	uint64_t hash = 0;
+	int x, y;
+	for(y = 0; y < 8; y++) {
+		for(x = 0; x < 8; x++) {
+			hash <<= 1;
+			if(grid[y * 9 + x] < grid[y * 9 + x + 1]) {
+				hash |= 1;
+			}
+		}
+	}
+	return hash;
+}
+
+static int av_compare_floats(const void *p1, const void *p2) {
+	float f1 = *(const float *) p1, f2 = *(const float *) p2;
+	return (f1 < f2) ? -1 : (f1 > f2) ? 1 : 0;
+}
+
+uint64_t av_compute_phash(const uint8_t *grid) {
+	// 32x32 grid: the lowest 8x8 DCT coefficients compared against their median (DC excluded)
+	float cosines[8][32], rows[32][8], coefficients[64], sorted[63], median;
+	uint64_t hash = 0;
+	int u, v, x, y;
+
+	for(u = 0; u < 8; u++) {
+		for(x = 0; x < 32; x++) {
+			cosines[u][x] = (float) cos((2 * x + 1) * u * M_PI / 64);
+		}
+	}
+	for(y = 0; y < 32; y++) {
+		for(u = 0; u < 8; u++) {
+			float sum = 0;
+			for(x = 0; x < 32; x++) {
+				sum += cosines[u][x] * grid[y * 32 + x];
+			}
+			rows[y][u] = sum;
+		}
+	}
+	for(v = 0; v < 8; v++) {
+		for(u = 0; u < 8; u++) {
+			float sum = 0;
+			for(y = 0; y < 32; y++) {
+				sum += cosines[v][y] * rows[y][u];
+			}
+			coefficients[v * 8 + u] = sum;
+		}
+	}
+	memcpy(sorted, coefficients + 1, sizeof(sorted));
+	qsort(sorted, 63, sizeof(float), av_compare_floats);
+	median = sorted[31];
+	for(u = 0; u < 64; u++) {
+		hash <<= 1;
+		if(coefficients[u] > median) {
+			hash |= 1;
+		}
+	}
+	return hash;
+}
+
+// frame statistics taken from what the decoder exports, without touching the pixels
+
+int av_compute_mean_qp(AVFrame *frame, int width, int height, double *p_qp) {
+#if !defined(FF_API_FRAME_QP) || FF_API_FRAME_QP
+	int stride, type;
+	int8_t *table = av_frame_get_qp_table(frame, &stride, &type);
+	if(table && width > 0 && height > 0) {
+		// one entry per 16x16 macroblock
+		int mb_width = (width + 15) >> 4, mb_height = (height + 15) >> 4;
+		int64_t sum = 0;
+		int x, y;
+		for(y = 0; y < mb_height; y++) {
+			const int8_t *row = table + y * stride;
+			for(x = 0; x < mb_width; x++) {
+				sum += row[x];
+			}
+		}
+		*p_qp = (double) sum / (mb_width * mb_height);
+		return TRUE;
+	}
+#endif
+	return FALSE;
+}
+
+int av_summarize_motion_vectors(AVFrame *frame, double *p_magnitude, long *p_count) {
+#ifdef AV_MOTION_VECTORS_SUPPORTED
+	AVFrameSideData *side_data = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+	double magnitude_sum = 0, area_sum = 0;
+	long count = 0;
+	if(side_data) {
+		const AVMotionVector *mvs = (const AVMotionVector *) side_data->data;
+		size_t i, mv_count = side_data->size / sizeof(AVMotionVector);
+		for(i = 0; i < mv_count; i++) {
+			// weigh each vector by the size of its block so the mean reflects the area in motion
+			double dx = mvs[i].dst_x - mvs[i].src_x, dy = mvs[i].dst_y - mvs[i].src_y;
+			double area = (double) mvs[i].w * mvs[i].h;
+			magnitude_sum += sqrt(dx * dx + dy * dy) * area;
+			area_sum += area;
+		}
+		count = (long) mv_count;
+	}
+	// intra-coded frames carry no vectors at all
+	*p_magnitude = (area_sum > 0) ? magnitude_sum / area_sum : 0;
+	*p_count = count;
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
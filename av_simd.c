@@ -0,0 +1,696 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "php.h"
+#include "php_av.h"
+#include <libavutil/cpu.h>
+
+// pixel conversion kernels, selected at startup according to what the CPU supports
+
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__)
+#	define AV_TARGET_ATTRIBUTES
+#endif
+
+// 32-bit builds only get SSE2 kernels when the compiler can emit SSE2 code for them
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) \
+ || ((defined(__i386__) || defined(_M_IX86)) && defined(AV_TARGET_ATTRIBUTES))
+#	define AV_SIMD_X86
+#	include <emmintrin.h>
+#	ifdef AV_TARGET_ATTRIBUTES
+#		define AV_TARGET_SSE2				__attribute__((target("sse2")))
+#	else
+#		define AV_TARGET_SSE2
+#	endif
+#	if defined(AV_TARGET_ATTRIBUTES)
+#		define AV_SIMD_AVX2
+#		define AV_TARGET_AVX2				__attribute__((target("avx2")))
+#		include <immintrin.h>
+#	elif defined(_MSC_VER) && _MSC_VER >= 1700
+#		define AV_SIMD_AVX2
+#		define AV_TARGET_AVX2
+#		include <immintrin.h>
+#	endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define AV_SIMD_NEON
+#	include <arm_neon.h>
+#endif
+
+#ifndef AV_CPU_FLAG_AVX2
+#	define AV_CPU_FLAG_AVX2				0x8000
+#endif
+
+av_gd_to_rgba_func av_gd_to_rgba = av_gd_to_rgba_c;
+av_rgb32_to_gd_func av_rgb32_to_gd = av_rgb32_to_gd_c;
+av_copy_clamped_float_func av_copy_clamped_float = av_copy_clamped_float_c;
+av_interleave_func av_interleave_samples = av_interleave_samples_c;
+av_deinterleave_func av_deinterleave_samples = av_deinterleave_samples_c;
+av_accumulate_range_func av_accumulate_range = av_accumulate_range_c;
+
+void av_gd_to_rgba_c(uint8_t *dst, const int *src, uint32_t count) {
+	uint32_t i;
+	for(i = 0; i < count; i++) {
+		int gd_pixel = src[i];
+		dst[0] = gdTrueColorGetRed(gd_pixel);
+		dst[1] = gdTrueColorGetGreen(gd_pixel);
+		dst[2] = gdTrueColorGetBlue(gd_pixel);
+		dst[3] = (gdAlphaMax - gdTrueColorGetAlpha(gd_pixel)) << 1;
+		dst += 4;
+	}
+}
+
+void av_rgb32_to_gd_c(int *dst, const uint32_t *src, uint32_t count, int has_alpha) {
+	uint32_t i;
+	if(has_alpha) {
+		// convert 8-bit alpha to gd's inverted 7-bit alpha
+		for(i = 0; i < count; i++) {
+			uint32_t argb = src[i];
+			dst[i] = (int) ((argb & 0x00FFFFFF) | ((gdAlphaMax - (argb >> 25)) << 24));
+		}
+	} else {
+		// opaque
+		for(i = 0; i < count; i++) {
+			dst[i] = (int) (src[i] & 0x00FFFFFF);
+		}
+	}
+}
+
+void av_copy_clamped_float_c(float *dst, const float *src, uint32_t count) {
+	// NaN fails both comparisons and becomes 1.0
+	uint32_t i;
+	for(i = 0; i < count; i++) {
+		float sample = src[i];
+		if(EXPECTED(-1.0f <= sample && sample <= 1.0f)) {
+			dst[i] = sample;
+		} else {
+			dst[i] = (sample < -1) ? -1.0f : 1.0f;
+		}
+	}
+}
+
+void av_interleave_samples_c(uint8_t *dst, uint8_t * const *src, uint32_t channels, uint32_t sample_size, uint32_t count) {
+	uint32_t i, c;
+	if(channels == 1) {
+		memcpy(dst, src[0], count * sample_size);
+		return;
+	}
+	for(c = 0; c < channels; c++) {
+		switch(sample_size) {
+			case 1: {
+				const uint8_t *s = src[c];
+				uint8_t *d = dst + c;
+				for(i = 0; i < count; i++, d += channels) *d = s[i];
+			}	break;
+			case 2: {
+				const uint16_t *s = (const uint16_t *) src[c];
+				uint16_t *d = (uint16_t *) dst + c;
+				for(i = 0; i < count; i++, d += channels) *d = s[i];
+			}	break;
+			case 4: {
+				const uint32_t *s = (const uint32_t *) src[c];
+				uint32_t *d = (uint32_t *) dst + c;
+				for(i = 0; i < count; i++, d += channels) *d = s[i];
+			}	break;
+			case 8: {
+				const uint64_t *s = (const uint64_t *) src[c];
+				uint64_t *d = (uint64_t *) dst + c;
+				for(i = 0; i < count; i++, d += channels) *d = s[i];
+			}	break;
+		}
+	}
+}
+
+void av_deinterleave_samples_c(uint8_t * const *dst, const uint8_t *src, uint32_t channels, uint32_t sample_size, uint32_t count) {
+	uint32_t i, c;
+	if(channels == 1) {
+		memcpy(dst[0], src, count * sample_size);
+		return;
+	}
+	for(c = 0; c < channels; c++) {
+		switch(sample_size) {
+			case 1: {
+				const uint8_t *s = src + c;
+				uint8_t *d = dst[c];
+				for(i = 0; i < count; i++, s += channels) d[i] = *s;
+			}	break;
+			case 2: {
+				const uint16_t *s = (const uint16_t *) src + c;
+				uint16_t *d = (uint16_t *) dst[c];
+				for(i = 0; i < count; i++, s += channels) d[i] = *s;
+			}	break;
+			case 4: {
+				const uint32_t *s = (const uint32_t *) src + c;
+				uint32_t *d = (uint32_t *) dst[c];
+				for(i = 0; i < count; i++, s += channels) d[i] = *s;
+			}	break;
+			case 8: {
+				const uint64_t *s = (const uint64_t *) src + c;
+				uint64_t *d = (uint64_t *) dst[c];
+				for(i = 0; i < count; i++, s += channels) d[i] = *s;
+			}	break;
+		}
+	}
+}
+
+void av_accumulate_range_c(const float *samples, uint32_t channels, uint32_t count, float *mins, float *maxs, double *square_sums) {
+	// mins, maxs and square_sums hold one running value per channel
+	uint32_t i, c;
+	for(i = 0; i < count; i++) {
+		for(c = 0; c < channels; c++) {
+			float sample = samples[c];
+			if(sample < mins[c]) {
+				mins[c] = sample;
+			}
+			if(sample > maxs[c]) {
+				maxs[c] = sample;
+			}
+			if(square_sums) {
+				square_sums[c] += sample * sample;
+			}
+		}
+		samples += channels;
+	}
+}
+
+#ifdef AV_SIMD_X86
+AV_TARGET_SSE2 void av_gd_to_rgba_sse2(uint8_t *dst, const int *src, uint32_t count) {
+	const __m128i mask_byte = _mm_set1_epi32(0xFF);
+	const __m128i mask_green = _mm_set1_epi32(0xFF00);
+	const __m128i mask_alpha = _mm_set1_epi32(0x7F);
+	const __m128i alpha_max = _mm_set1_epi32(gdAlphaMax);
+	uint32_t i;
+	for(i = 0; i + 4 <= count; i += 4) {
+		__m128i argb = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i r = _mm_and_si128(_mm_srli_epi32(argb, 16), mask_byte);
+		__m128i g = _mm_and_si128(argb, mask_green);
+		__m128i b = _mm_slli_epi32(_mm_and_si128(argb, mask_byte), 16);
+		__m128i a = _mm_sub_epi32(alpha_max, _mm_and_si128(_mm_srli_epi32(argb, 24), mask_alpha));
+		__m128i rgba = _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, _mm_slli_epi32(a, 25)));
+		_mm_storeu_si128((__m128i *) (dst + i * 4), rgba);
+	}
+	if(i < count) {
+		av_gd_to_rgba_c(dst + i * 4, src + i, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_X86
+AV_TARGET_SSE2 void av_rgb32_to_gd_sse2(int *dst, const uint32_t *src, uint32_t count, int has_alpha) {
+	const __m128i mask_rgb = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i alpha_max = _mm_set1_epi32(gdAlphaMax);
+	uint32_t i;
+	for(i = 0; i + 4 <= count; i += 4) {
+		__m128i argb = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i gd_pixel = _mm_and_si128(argb, mask_rgb);
+		if(has_alpha) {
+			__m128i a = _mm_sub_epi32(alpha_max, _mm_srli_epi32(argb, 25));
+			gd_pixel = _mm_or_si128(gd_pixel, _mm_slli_epi32(a, 24));
+		}
+		_mm_storeu_si128((__m128i *) (dst + i), gd_pixel);
+	}
+	if(i < count) {
+		av_rgb32_to_gd_c(dst + i, src + i, count - i, has_alpha);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_X86
+AV_TARGET_SSE2 void av_copy_clamped_float_sse2(float *dst, const float *src, uint32_t count) {
+	// minps/maxps return the second operand when the first is NaN, so clamping
+	// against the upper bound first turns NaN into 1.0 like the C version
+	const __m128 upper = _mm_set1_ps(1.0f);
+	const __m128 lower = _mm_set1_ps(-1.0f);
+	uint32_t i;
+	for(i = 0; i + 8 <= count; i += 8) {
+		__m128 a = _mm_loadu_ps(src + i);
+		__m128 b = _mm_loadu_ps(src + i + 4);
+		_mm_storeu_ps(dst + i, _mm_max_ps(_mm_min_ps(a, upper), lower));
+		_mm_storeu_ps(dst + i + 4, _mm_max_ps(_mm_min_ps(b, upper), lower));
+	}
+	if(i < count) {
+		av_copy_clamped_float_c(dst + i, src + i, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_X86
+AV_TARGET_SSE2 void av_interleave_samples_sse2(uint8_t *dst, uint8_t * const *src, uint32_t channels, uint32_t sample_size, uint32_t count) {
+	// only stereo gets special treatment; everything else is handled by the C version
+	uint32_t i, per_vector = 16 / sample_size;
+	uint8_t *remaining[2];
+	if(channels != 2) {
+		av_interleave_samples_c(dst, src, channels, sample_size, count);
+		return;
+	}
+	for(i = 0; i + per_vector <= count; i += per_vector) {
+		__m128i l = _mm_loadu_si128((const __m128i *) (src[0] + i * sample_size));
+		__m128i r = _mm_loadu_si128((const __m128i *) (src[1] + i * sample_size));
+		__m128i lo, hi;
+		switch(sample_size) {
+			case 1: lo = _mm_unpacklo_epi8(l, r); hi = _mm_unpackhi_epi8(l, r); break;
+			case 2: lo = _mm_unpacklo_epi16(l, r); hi = _mm_unpackhi_epi16(l, r); break;
+			case 4: lo = _mm_unpacklo_epi32(l, r); hi = _mm_unpackhi_epi32(l, r); break;
+			default: lo = _mm_unpacklo_epi64(l, r); hi = _mm_unpackhi_epi64(l, r); break;
+		}
+		_mm_storeu_si128((__m128i *) (dst + i * sample_size * 2), lo);
+		_mm_storeu_si128((__m128i *) (dst + i * sample_size * 2 + 16), hi);
+	}
+	if(i < count) {
+		remaining[0] = src[0] + i * sample_size;
+		remaining[1] = src[1] + i * sample_size;
+		av_interleave_samples_c(dst + i * sample_size * 2, remaining, 2, sample_size, count - i);
+	}
+}
+
+AV_TARGET_SSE2 void av_deinterleave_samples_sse2(uint8_t * const *dst, const uint8_t *src, uint32_t channels, uint32_t sample_size, uint32_t count) {
+	const __m128i mask_byte = _mm_set1_epi16(0xFF);
+	uint32_t i, per_vector = 16 / sample_size;
+	uint8_t *remaining[2];
+	if(channels != 2) {
+		av_deinterleave_samples_c(dst, src, channels, sample_size, count);
+		return;
+	}
+	for(i = 0; i + per_vector <= count; i += per_vector) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (src + i * sample_size * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *) (src + i * sample_size * 2 + 16));
+		__m128i l, r;
+		switch(sample_size) {
+			case 1:
+				l = _mm_packus_epi16(_mm_and_si128(a, mask_byte), _mm_and_si128(b, mask_byte));
+				r = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+				break;
+			case 2:
+				// sign-extend each half so the saturating pack leaves the values alone
+				l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+				r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+				break;
+			case 4:
+				l = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+				r = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+				break;
+			default:
+				l = _mm_unpacklo_epi64(a, b);
+				r = _mm_unpackhi_epi64(a, b);
+				break;
+		}
+		_mm_storeu_si128((__m128i *) (dst[0] + i * sample_size), l);
+		_mm_storeu_si128((__m128i *) (dst[1] + i * sample_size), r);
+	}
+	if(i < count) {
+		remaining[0] = dst[0] + i * sample_size;
+		remaining[1] = dst[1] + i * sample_size;
+		av_deinterleave_samples_c(remaining, src + i * sample_size * 2, 2, sample_size, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_X86
+AV_TARGET_SSE2 void av_accumulate_range_sse2(const float *samples, uint32_t channels, uint32_t count, float *mins, float *maxs, double *square_sums) {
+	// with 1, 2 or 4 channels, lane n of a vector always holds channel n % channels;
+	// squares are summed in double precision like the C version
+	__m128 min_vector, max_vector;
+	__m128d sum_low = _mm_setzero_pd(), sum_high = _mm_setzero_pd();
+	float lane_mins[4], lane_maxs[4];
+	double lane_sums[4];
+	uint32_t i, c, total = count * channels;
+	if(channels != 1 && channels != 2 && channels != 4) {
+		av_accumulate_range_c(samples, channels, count, mins, maxs, square_sums);
+		return;
+	}
+	for(i = 0; i < 4; i++) {
+		lane_mins[i] = mins[i % channels];
+		lane_maxs[i] = maxs[i % channels];
+	}
+	min_vector = _mm_loadu_ps(lane_mins);
+	max_vector = _mm_loadu_ps(lane_maxs);
+	for(i = 0; i + 4 <= total; i += 4) {
+		__m128 v = _mm_loadu_ps(samples + i);
+		__m128 squares = _mm_mul_ps(v, v);
+		min_vector = _mm_min_ps(min_vector, v);
+		max_vector = _mm_max_ps(max_vector, v);
+		sum_low = _mm_add_pd(sum_low, _mm_cvtps_pd(squares));
+		sum_high = _mm_add_pd(sum_high, _mm_cvtps_pd(_mm_movehl_ps(squares, squares)));
+	}
+	_mm_storeu_ps(lane_mins, min_vector);
+	_mm_storeu_ps(lane_maxs, max_vector);
+	_mm_storeu_pd(lane_sums, sum_low);
+	_mm_storeu_pd(lane_sums + 2, sum_high);
+	for(c = 0; c < 4; c++) {
+		uint32_t channel = c % channels;
+		if(lane_mins[c] < mins[channel]) {
+			mins[channel] = lane_mins[c];
+		}
+		if(lane_maxs[c] > maxs[channel]) {
+			maxs[channel] = lane_maxs[c];
+		}
+		if(square_sums) {
+			square_sums[channel] += lane_sums[c];
+		}
+	}
+	if(i < total) {
+		av_accumulate_range_c(samples + i, channels, (total - i) / channels, mins, maxs, square_sums);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_AVX2
+AV_TARGET_AVX2 void av_gd_to_rgba_avx2(uint8_t *dst, const int *src, uint32_t count) {
+	const __m256i mask_byte = _mm256_set1_epi32(0xFF);
+	const __m256i mask_green = _mm256_set1_epi32(0xFF00);
+	const __m256i mask_alpha = _mm256_set1_epi32(0x7F);
+	const __m256i alpha_max = _mm256_set1_epi32(gdAlphaMax);
+	uint32_t i;
+	for(i = 0; i + 8 <= count; i += 8) {
+		__m256i argb = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i r = _mm256_and_si256(_mm256_srli_epi32(argb, 16), mask_byte);
+		__m256i g = _mm256_and_si256(argb, mask_green);
+		__m256i b = _mm256_slli_epi32(_mm256_and_si256(argb, mask_byte), 16);
+		__m256i a = _mm256_sub_epi32(alpha_max, _mm256_and_si256(_mm256_srli_epi32(argb, 24), mask_alpha));
+		__m256i rgba = _mm256_or_si256(_mm256_or_si256(r, g), _mm256_or_si256(b, _mm256_slli_epi32(a, 25)));
+		_mm256_storeu_si256((__m256i *) (dst + i * 4), rgba);
+	}
+	if(i < count) {
+		av_gd_to_rgba_sse2(dst + i * 4, src + i, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_AVX2
+AV_TARGET_AVX2 void av_rgb32_to_gd_avx2(int *dst, const uint32_t *src, uint32_t count, int has_alpha) {
+	const __m256i mask_rgb = _mm256_set1_epi32(0x00FFFFFF);
+	const __m256i alpha_max = _mm256_set1_epi32(gdAlphaMax);
+	uint32_t i;
+	for(i = 0; i + 8 <= count; i += 8) {
+		__m256i argb = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i gd_pixel = _mm256_and_si256(argb, mask_rgb);
+		if(has_alpha) {
+			__m256i a = _mm256_sub_epi32(alpha_max, _mm256_srli_epi32(argb, 25));
+			gd_pixel = _mm256_or_si256(gd_pixel, _mm256_slli_epi32(a, 24));
+		}
+		_mm256_storeu_si256((__m256i *) (dst + i), gd_pixel);
+	}
+	if(i < count) {
+		av_rgb32_to_gd_sse2(dst + i, src + i, count - i, has_alpha);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_AVX2
+AV_TARGET_AVX2 void av_copy_clamped_float_avx2(float *dst, const float *src, uint32_t count) {
+	const __m256 upper = _mm256_set1_ps(1.0f);
+	const __m256 lower = _mm256_set1_ps(-1.0f);
+	uint32_t i;
+	for(i = 0; i + 16 <= count; i += 16) {
+		__m256 a = _mm256_loadu_ps(src + i);
+		__m256 b = _mm256_loadu_ps(src + i + 8);
+		_mm256_storeu_ps(dst + i, _mm256_max_ps(_mm256_min_ps(a, upper), lower));
+		_mm256_storeu_ps(dst + i + 8, _mm256_max_ps(_mm256_min_ps(b, upper), lower));
+	}
+	if(i < count) {
+		av_copy_clamped_float_sse2(dst + i, src + i, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_NEON
+void av_gd_to_rgba_neon(uint8_t *dst, const int *src, uint32_t count) {
+	const uint8x16_t mask_alpha = vdupq_n_u8(0x7F);
+	const uint8x16_t alpha_max = vdupq_n_u8(gdAlphaMax);
+	uint32_t i;
+	for(i = 0; i + 16 <= count; i += 16) {
+		// bytes of a little-endian gd pixel are B, G, R, A
+		uint8x16x4_t bgra = vld4q_u8((const uint8_t *) (src + i));
+		uint8x16x4_t rgba;
+		rgba.val[0] = bgra.val[2];
+		rgba.val[1] = bgra.val[1];
+		rgba.val[2] = bgra.val[0];
+		rgba.val[3] = vshlq_n_u8(vsubq_u8(alpha_max, vandq_u8(bgra.val[3], mask_alpha)), 1);
+		vst4q_u8(dst + i * 4, rgba);
+	}
+	if(i < count) {
+		av_gd_to_rgba_c(dst + i * 4, src + i, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_NEON
+void av_rgb32_to_gd_neon(int *dst, const uint32_t *src, uint32_t count, int has_alpha) {
+	const uint32x4_t mask_rgb = vdupq_n_u32(0x00FFFFFF);
+	const uint32x4_t alpha_max = vdupq_n_u32(gdAlphaMax);
+	uint32_t i;
+	for(i = 0; i + 4 <= count; i += 4) {
+		uint32x4_t argb = vld1q_u32(src + i);
+		uint32x4_t gd_pixel = vandq_u32(argb, mask_rgb);
+		if(has_alpha) {
+			uint32x4_t a = vsubq_u32(alpha_max, vshrq_n_u32(argb, 25));
+			gd_pixel = vorrq_u32(gd_pixel, vshlq_n_u32(a, 24));
+		}
+		vst1q_u32((uint32_t *) (dst + i), gd_pixel);
+	}
+	if(i < count) {
+		av_rgb32_to_gd_c(dst + i, src + i, count - i, has_alpha);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_NEON
+void av_copy_clamped_float_neon(float *dst, const float *src, uint32_t count) {
+	// vminq/vmaxq propagate NaN, so select the bound explicitly when a sample is out of range
+	const float32x4_t upper = vdupq_n_f32(1.0f);
+	const float32x4_t lower = vdupq_n_f32(-1.0f);
+	uint32_t i;
+	for(i = 0; i + 4 <= count; i += 4) {
+		float32x4_t sample = vld1q_f32(src + i);
+		uint32x4_t in_range = vandq_u32(vcleq_f32(lower, sample), vcleq_f32(sample, upper));
+		float32x4_t bound = vbslq_f32(vcltq_f32(sample, lower), lower, upper);
+		vst1q_f32(dst + i, vbslq_f32(in_range, sample, bound));
+	}
+	if(i < count) {
+		av_copy_clamped_float_c(dst + i, src + i, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_NEON
+void av_interleave_samples_neon(uint8_t *dst, uint8_t * const *src, uint32_t channels, uint32_t sample_size, uint32_t count) {
+	uint32_t i = 0;
+	uint8_t *remaining[2];
+	if(channels != 2) {
+		av_interleave_samples_c(dst, src, channels, sample_size, count);
+		return;
+	}
+	switch(sample_size) {
+		case 1:
+			for(; i + 16 <= count; i += 16) {
+				uint8x16x2_t lr = { { vld1q_u8(src[0] + i), vld1q_u8(src[1] + i) } };
+				vst2q_u8(dst + i * 2, lr);
+			}
+			break;
+		case 2:
+			for(; i + 8 <= count; i += 8) {
+				uint16x8x2_t lr = { { vld1q_u16((const uint16_t *) src[0] + i), vld1q_u16((const uint16_t *) src[1] + i) } };
+				vst2q_u16((uint16_t *) dst + i * 2, lr);
+			}
+			break;
+		case 4:
+			for(; i + 4 <= count; i += 4) {
+				uint32x4x2_t lr = { { vld1q_u32((const uint32_t *) src[0] + i), vld1q_u32((const uint32_t *) src[1] + i) } };
+				vst2q_u32((uint32_t *) dst + i * 2, lr);
+			}
+			break;
+	}
+	if(i < count) {
+		remaining[0] = src[0] + i * sample_size;
+		remaining[1] = src[1] + i * sample_size;
+		av_interleave_samples_c(dst + i * sample_size * 2, remaining, 2, sample_size, count - i);
+	}
+}
+
+void av_deinterleave_samples_neon(uint8_t * const *dst, const uint8_t *src, uint32_t channels, uint32_t sample_size, uint32_t count) {
+	uint32_t i = 0;
+	uint8_t *remaining[2];
+	if(channels != 2) {
+		av_deinterleave_samples_c(dst, src, channels, sample_size, count);
+		return;
+	}
+	switch(sample_size) {
+		case 1:
+			for(; i + 16 <= count; i += 16) {
+				uint8x16x2_t lr = vld2q_u8(src + i * 2);
+				vst1q_u8(dst[0] + i, lr.val[0]);
+				vst1q_u8(dst[1] + i, lr.val[1]);
+			}
+			break;
+		case 2:
+			for(; i + 8 <= count; i += 8) {
+				uint16x8x2_t lr = vld2q_u16((const uint16_t *) src + i * 2);
+				vst1q_u16((uint16_t *) dst[0] + i, lr.val[0]);
+				vst1q_u16((uint16_t *) dst[1] + i, lr.val[1]);
+			}
+			break;
+		case 4:
+			for(; i + 4 <= count; i += 4) {
+				uint32x4x2_t lr = vld2q_u32((const uint32_t *) src + i * 2);
+				vst1q_u32((uint32_t *) dst[0] + i, lr.val[0]);
+				vst1q_u32((uint32_t *) dst[1] + i, lr.val[1]);
+			}
+			break;
+	}
+	if(i < count) {
+		remaining[0] = dst[0] + i * sample_size;
+		remaining[1] = dst[1] + i * sample_size;
+		av_deinterleave_samples_c(remaining, src + i * sample_size * 2, 2, sample_size, count - i);
+	}
+}
+#endif
+
+#ifdef AV_SIMD_NEON
+void av_accumulate_range_neon(const float *samples, uint32_t channels, uint32_t count, float *mins, float *maxs, double *square_sums) {
+	float32x4_t min_vector, max_vector;
+#if defined(__aarch64__)
+	float64x2_t sum_low = vdupq_n_f64(0), sum_high = vdupq_n_f64(0);
+#else
+	float squares[4];
+#endif
+	float lane_mins[4], lane_maxs[4];
+	double lane_sums[4] = { 0, 0, 0, 0 };
+	uint32_t i, c, total = count * channels;
+	if(channels != 1 && channels != 2 && channels != 4) {
+		av_accumulate_range_c(samples, channels, count, mins, maxs, square_sums);
+		return;
+	}
+	for(i = 0; i < 4; i++) {
+		lane_mins[i] = mins[i % channels];
+		lane_maxs[i] = maxs[i % channels];
+	}
+	min_vector = vld1q_f32(lane_mins);
+	max_vector = vld1q_f32(lane_maxs);
+	for(i = 0; i + 4 <= total; i += 4) {
+		float32x4_t v = vld1q_f32(samples + i);
+		min_vector = vminq_f32(min_vector, v);
+		max_vector = vmaxq_f32(max_vector, v);
+		// squares are summed in double precision like the C version; 32-bit NEON has no double lanes
+#if defined(__aarch64__)
+		sum_low = vaddq_f64(sum_low, vcvt_f64_f32(vget_low_f32(vmulq_f32(v, v))));
+		sum_high = vaddq_f64(sum_high, vcvt_high_f64_f32(vmulq_f32(v, v)));
+#else
+		vst1q_f32(squares, vmulq_f32(v, v));
+		lane_sums[0] += squares[0];
+		lane_sums[1] += squares[1];
+		lane_sums[2] += squares[2];
+		lane_sums[3] += squares[3];
+#endif
+	}
+	vst1q_f32(lane_mins, min_vector);
+	vst1q_f32(lane_maxs, max_vector);
+#if defined(__aarch64__)
+	vst1q_f64(lane_sums, sum_low);
+	vst1q_f64(lane_sums + 2, sum_high);
+#endif
+	for(c = 0; c < 4; c++) {
+		uint32_t channel = c % channels;
+		if(lane_mins[c] < mins[channel]) {
+			mins[channel] = lane_mins[c];
+		}
+		if(lane_maxs[c] > maxs[channel]) {
+			maxs[channel] = lane_maxs[c];
+		}
+		if(square_sums) {
+			square_sums[channel] += lane_sums[c];
+		}
+	}
+	if(i < total) {
+		av_accumulate_range_c(samples + i, channels, (total - i) / channels, mins, maxs, square_sums);
+	}
+}
+#endif
+
+enum {
+	AV_SIMD_LEVEL_NONE = 0,
+	AV_SIMD_LEVEL_SSE2,					// also NEON
+	AV_SIMD_LEVEL_AVX2,
+	AV_SIMD_LEVEL_BEST,
+};
+
+int av_strcasecmp(const char *a, const char *b);
+
+static int av_get_simd_level(const char *name) {
+	// av.simd is a boolean, or the name of the highest instruction set to use
+	static const struct {
+		const char *name;
+		int level;
+	} levels[] = {
+		{ "",		AV_SIMD_LEVEL_NONE },
+		{ "0",		AV_SIMD_LEVEL_NONE },
+		{ "off",	AV_SIMD_LEVEL_NONE },
+		{ "no",		AV_SIMD_LEVEL_NONE },
+		{ "false",	AV_SIMD_LEVEL_NONE },
+		{ "none",	AV_SIMD_LEVEL_NONE },
+		{ "sse2",	AV_SIMD_LEVEL_SSE2 },
+		{ "neon",	AV_SIMD_LEVEL_SSE2 },
+		{ "avx2",	AV_SIMD_LEVEL_AVX2 },
+	};
+	uint32_t i;
+	if(!name) {
+		return AV_SIMD_LEVEL_BEST;
+	}
+	for(i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+		if(av_strcasecmp(name, levels[i].name) == 0) {
+			return levels[i].level;
+		}
+	}
+	return AV_SIMD_LEVEL_BEST;
+}
+
+void av_init_simd(const char *level_name) {
+	int flags = av_get_cpu_flags();
+	int level = av_get_simd_level(level_name);
+	if(level == AV_SIMD_LEVEL_NONE) {
+		return;
+	}
+#if defined(AV_SIMD_X86)
+	if(flags & AV_CPU_FLAG_SSE2) {
+		av_gd_to_rgba = av_gd_to_rgba_sse2;
+		av_rgb32_to_gd = av_rgb32_to_gd_sse2;
+		av_copy_clamped_float = av_copy_clamped_float_sse2;
+		av_interleave_samples = av_interleave_samples_sse2;
+		av_deinterleave_samples = av_deinterleave_samples_sse2;
+		av_accumulate_range = av_accumulate_range_sse2;
+	}
+#	if defined(AV_SIMD_AVX2)
+	if((flags & AV_CPU_FLAG_AVX2) && level >= AV_SIMD_LEVEL_AVX2) {
+		av_gd_to_rgba = av_gd_to_rgba_avx2;
+		av_rgb32_to_gd = av_rgb32_to_gd_avx2;
+		av_copy_clamped_float = av_copy_clamped_float_avx2;
+	}
+#	endif
+#elif defined(AV_SIMD_NEON)
+	av_gd_to_rgba = av_gd_to_rgba_neon;
+	av_rgb32_to_gd = av_rgb32_to_gd_neon;
+	av_copy_clamped_float = av_copy_clamped_float_neon;
+	av_interleave_samples = av_interleave_samples_neon;
+	av_deinterleave_samples = av_deinterleave_samples_neon;
+	av_accumulate_range = av_accumulate_range_neon;
+#endif
+	(void) flags;
+	(void) level;
+}
+
+const char *av_get_simd_name(void) {
+#if defined(AV_SIMD_AVX2)
+	if(av_gd_to_rgba == av_gd_to_rgba_avx2) {
+		return "AVX2";
+	}
+#endif
+#if defined(AV_SIMD_X86)
+	if(av_gd_to_rgba == av_gd_to_rgba_sse2) {
+		return "SSE2";
+	}
+#endif
+#if defined(AV_SIMD_NEON)
+	if(av_gd_to_rgba == av_gd_to_rgba_neon) {
+		return "NEON";
+	}
+#endif
+	return "none";
+}
@@ -5,6 +5,13 @@
 #include "php.h"
 #include "php_av.h"
 
+#ifndef PHP_WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
 int av_get_element_long(zval *array, const char *key, long *p_value) {
 	if(array) {
 		if(Z_TYPE_P(array) == IS_ARRAY) {
@@ -119,7 +126,7 @@ void av_set_element_stringl(zval *array, const char *key, const char *value, lon
 	zend_hash_update(Z_ARRVAL_P(array), key, (uint32_t) strlen(key) + 1, (void *) &element, sizeof(zval *), NULL);
 }
 
-zval *av_create_gd_image(uint32_t width, uint32_t height TSRMLS_DC) {
+static zval *av_call_gd_constructor(const char *function_name, uint32_t width, uint32_t height TSRMLS_DC) {
 	zval *z_width, *z_height, *z_function_name, *z_retval = NULL;
 	zval **params[2];
 
@@ -128,7 +135,7 @@ zval *av_create_gd_image(uint32_t width, uint32_t height TSRMLS_DC) {
 	ALLOC_INIT_ZVAL(z_function_name);
 	ZVAL_LONG(z_width, width);
 	ZVAL_LONG(z_height, height);
-	ZVAL_STRING(z_function_name, "imagecreate", TRUE);
+	ZVAL_STRING(z_function_name, function_name, TRUE);
 	params[0] = &z_width;
 	params[1] = &z_height;
 	call_user_function_ex(CG(function_table), NULL, z_function_name, &z_retval, 2, params, TRUE, NULL TSRMLS_CC);
@@ -138,6 +145,170 @@ zval *av_create_gd_image(uint32_t width, uint32_t height TSRMLS_DC) {
 	return z_retval;
 }
 
+zval *av_create_gd_image(uint32_t width, uint32_t height TSRMLS_DC) {
+	return av_call_gd_constructor("imagecreate", width, height TSRMLS_CC);
+}
+
+zval *av_create_gd_truecolor_image(uint32_t width, uint32_t height TSRMLS_DC) {
+	return av_call_gd_constructor("imagecreatetruecolor", width, height TSRMLS_CC);
+}
+
+#ifdef PHP_WIN32
+
+int av_thread_create(av_thread *thread, av_thread_proc proc, void *arg) {
+	*thread = CreateThread(NULL, 0, proc, arg, 0, NULL);
+	return (*thread != NULL);
+}
+
+void av_thread_join(av_thread thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+void av_mutex_init(av_mutex *mutex) {
+	InitializeCriticalSection(mutex);
+}
+
+void av_mutex_destroy(av_mutex *mutex) {
+	DeleteCriticalSection(mutex);
+}
+
+void av_mutex_lock(av_mutex *mutex) {
+	EnterCriticalSection(mutex);
+}
+
+void av_mutex_unlock(av_mutex *mutex) {
+	LeaveCriticalSection(mutex);
+}
+
+void av_cond_init(av_cond *cond) {
+	InitializeConditionVariable(cond);
+}
+
+void av_cond_destroy(av_cond *cond) {
+}
+
+void av_cond_wait(av_cond *cond, av_mutex *mutex) {
+	SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+void av_cond_signal(av_cond *cond) {
+	WakeConditionVariable(cond);
+}
+
+void av_cond_broadcast(av_cond *cond) {
+	WakeAllConditionVariable(cond);
+}
+
+#else
+
+int av_thread_create(av_thread *thread, av_thread_proc proc, void *arg) {
+	return (pthread_create(thread, NULL, proc, arg) == 0);
+}
+
+void av_thread_join(av_thread thread) {
+	pthread_join(thread, NULL);
+}
+
+void av_mutex_init(av_mutex *mutex) {
+	pthread_mutex_init(mutex, NULL);
+}
+
+void av_mutex_destroy(av_mutex *mutex) {
+	pthread_mutex_destroy(mutex);
+}
+
+void av_mutex_lock(av_mutex *mutex) {
+	pthread_mutex_lock(mutex);
+}
+
+void av_mutex_unlock(av_mutex *mutex) {
+	pthread_mutex_unlock(mutex);
+}
+
+void av_cond_init(av_cond *cond) {
+	pthread_cond_init(cond, NULL);
+}
+
+void av_cond_destroy(av_cond *cond) {
+	pthread_cond_destroy(cond);
+}
+
+void av_cond_wait(av_cond *cond, av_mutex *mutex) {
+	pthread_cond_wait(cond, mutex);
+}
+
+void av_cond_signal(av_cond *cond) {
+	pthread_cond_signal(cond);
+}
+
+void av_cond_broadcast(av_cond *cond) {
+	pthread_cond_broadcast(cond);
+}
+
+#endif
+
+#ifdef PHP_WIN32
+
+int av_shared_memory_create(av_shared_memory *shm, const char *name, size_t size) {
+	uint64_t size64 = size;
+	shm->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD) (size64 >> 32), (DWORD) size64, name);
+	if(!shm->handle) {
+		return FALSE;
+	}
+	if(GetLastError() == ERROR_ALREADY_EXISTS) {
+		// someone else's mapping--leave it alone
+		CloseHandle(shm->handle);
+		return AV_SHARED_MEMORY_EXISTS;
+	}
+	shm->base = MapViewOfFile(shm->handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if(!shm->base) {
+		CloseHandle(shm->handle);
+		return FALSE;
+	}
+	shm->size = size;
+	return TRUE;
+}
+
+void av_shared_memory_destroy(av_shared_memory *shm) {
+	UnmapViewOfFile(shm->base);
+	CloseHandle(shm->handle);
+}
+
+#else
+
+int av_shared_memory_create(av_shared_memory *shm, const char *name, size_t size) {
+	void *base;
+	// never reuse (and resize) a region another process might still have mapped
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if(fd == -1) {
+		return (errno == EEXIST) ? AV_SHARED_MEMORY_EXISTS : FALSE;
+	}
+	if(ftruncate(fd, size) != 0) {
+		close(fd);
+		shm_unlink(name);
+		return FALSE;
+	}
+	base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED) {
+		shm_unlink(name);
+		return FALSE;
+	}
+	shm->base = base;
+	shm->size = size;
+	shm->name = strdup(name);
+	return TRUE;
+}
+
+void av_shared_memory_destroy(av_shared_memory *shm) {
+	munmap(shm->base, shm->size);
+	shm_unlink(shm->name);
+	free(shm->name);
+}
+
+#endif
+
 #ifdef USE_CUSTOM_MALLOC
 
 void *custom_malloc(size_t size) {
@@ -0,0 +1,39 @@
+<?php
+
+// Times av_stream_write_pcm() on a large buffer of stereo float samples, with and without
+// the "trusted_input" option that skips clamping. Both runs encode to FLAC, so the
+// difference between them is the cost of the clamp-and-copy kernel.
+//
+//   php bench/pcm-clamp.php [seconds]
+//   php -d av.simd=0 bench/pcm-clamp.php [seconds]
+
+$seconds = isset($argv[1]) ? max(10, (int) $argv[1] - (int) $argv[1] % 10) : 120;
+$sample_rate = 48000;
+$path = sys_get_temp_dir() . "/av-bench-pcm-clamp.flac";
+
+// one second of a slightly overdriven tone, so some samples do need clamping
+$chunk = '';
+for($i = 0; $i < $sample_rate; $i++) {
+	$sample = sin($i * 440 * 2 * M_PI / $sample_rate) * 1.2;
+	$chunk .= pack("ff", $sample, -$sample);
+}
+$buffer = str_repeat($chunk, 10);
+$sample_count = $seconds * $sample_rate * 2;
+
+printf("SIMD kernels: %s, %d seconds of stereo float samples\n", ini_get("av.simd") ? "on" : "off", $seconds);
+$timings = array();
+foreach(array("clamped" => false, "trusted_input" => true) as $label => $trusted) {
+	$file = av_file_open($path, "w");
+	$strm = av_stream_open($file, "audio", array("sampling_rate" => $sample_rate, "channels" => 2, "pcm_format" => "flt", "pcm_sample_rate" => $sample_rate, "pcm_channels" => 2, "trusted_input" => $trusted));
+	$start = microtime(true);
+	for($i = 0; $i < $seconds; $i += 10) {
+		av_stream_write_pcm($strm, $buffer);
+	}
+	$timings[$label] = microtime(true) - $start;
+	av_file_close($file);
+	printf("%-14s %8.1f Msamples/s\n", $label, $sample_count / $timings[$label] / 1e6);
+}
+printf("%-14s %8.2f ns/sample\n", "clamp cost", ($timings["clamped"] - $timings["trusted_input"]) * 1e9 / $sample_count);
+unlink($path);
+
+?>
@@ -0,0 +1,53 @@
+<?php
+
+// Decodes the same 1080p clip with each scaling algorithm and reports frames per second.
+// Decoding without conversion is timed first, so what each algorithm adds can be told
+// apart from the cost of decoding.
+//
+//   php bench/scaling.php [width] [height]
+
+$width = isset($argv[1]) ? (int) $argv[1] : 320;
+$height = isset($argv[2]) ? (int) $argv[2] : 180;
+$frame_count = 96;
+$algorithms = array("fast_bilinear", "bilinear", "bicubic", "bicublin", "point", "area", "gauss", "sinc", "lanczos", "spline", "experimental");
+$path = sys_get_temp_dir() . "/av-bench-scaling.mp4";
+
+// a gradient with moving bars, so the frames aren't trivial to decode
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 1920, "height" => 1080, "frame_rate" => 24, "bit_rate" => 8000000));
+$image = imagecreatetruecolor(1920, 1080);
+for($i = 0; $i < $frame_count; $i++) {
+	for($x = 0; $x < 1920; $x += 16) {
+		imagefilledrectangle($image, $x, 0, $x + 15, 1079, imagecolorallocate($image, ($x + $i * 8) & 0xFF, ($x >> 3) & 0xFF, 255 - (($x + $i * 4) & 0xFF)));
+	}
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+imagedestroy($image);
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video");
+// av_stream_read_frame_info() decodes without scaling or copying the planes
+$start = microtime(true);
+$count = count(av_stream_read_frame_info($strm));
+$elapsed = microtime(true) - $start;
+av_file_close($file);
+printf("1920x1080 -> %dx%d, %d frames\n", $width, $height, $count);
+printf("%-14s %8.1f fps\n", "(decode only)", $count / $elapsed);
+
+$image = imagecreatetruecolor($width, $height);
+foreach($algorithms as $algorithm) {
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "video", array("scaling" => $algorithm));
+	$start = microtime(true);
+	$count = 0;
+	while(av_stream_read_image($strm, $image, $time)) {
+		$count++;
+	}
+	$elapsed = microtime(true) - $start;
+	av_file_close($file);
+	printf("%-14s %8.1f fps\n", $algorithm, $count / $elapsed);
+}
+unlink($path);
+
+?>
@@ -0,0 +1,63 @@
+<?php
+
+// Times precise seeks into a long-GOP video, once decoding every frame on the way to the
+// time sought ("fast_seek" => false) and once skipping the frames nothing references.
+// Only files with non-reference frames (B-frames, for instance) gain anything, so the
+// generated clip uses them; a long-GOP H.264 file can be given instead.
+//
+//   php bench/seek.php [file] [seek count]
+
+$seek_count = isset($argv[2]) ? (int) $argv[2] : 50;
+if(isset($argv[1])) {
+	$path = $argv[1];
+	$generated = false;
+} else {
+	// 40 seconds of 720p with a key frame every 10 seconds
+	$path = sys_get_temp_dir() . "/av-bench-seek.mp4";
+	$generated = true;
+	$file = av_file_open($path, "w");
+	$strm = av_stream_open($file, "video", array("width" => 1280, "height" => 720, "frame_rate" => 24, "gop" => 240, "b_frames" => 2, "bit_rate" => 4000000));
+	$image = imagecreatetruecolor(1280, 720);
+	for($i = 0; $i < 24 * 40; $i++) {
+		imagefilledrectangle($image, 0, 0, 1279, 719, imagecolorallocate($image, 20, 40, 80));
+		imagefilledellipse($image, 160 + ($i * 7) % 960, 360 + (int) (200 * sin($i / 12)), 240, 240, imagecolorallocate($image, 240, $i & 0xFF, 40));
+		av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+	}
+	av_file_close($file);
+	imagedestroy($image);
+}
+
+$file = av_file_open($path, "r");
+$info = av_file_stat($file);
+av_file_close($file);
+$duration = $info['duration'];
+
+// the same targets for both runs
+mt_srand(1234);
+$targets = array();
+for($i = 0; $i < $seek_count; $i++) {
+	$targets[] = mt_rand(0, (int) ($duration * 1000) - 1000) / 1000;
+}
+
+printf("%s, %.1f seconds, %d seeks\n", basename($path), $duration, $seek_count);
+$image = imagecreatetruecolor(320, 180);
+foreach(array("full decode" => false, "skip non-ref" => true) as $label => $fast_seek) {
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "video", array("fast_seek" => $fast_seek));
+	$timings = array();
+	foreach($targets as $target) {
+		$start = microtime(true);
+		av_file_seek($file, $target);
+		av_stream_read_image($strm, $image, $time);
+		$timings[] = microtime(true) - $start;
+	}
+	av_file_close($file);
+	sort($timings);
+	printf("%-14s mean %7.1f ms  median %7.1f ms  max %7.1f ms\n", $label,
+		array_sum($timings) * 1000 / count($timings), $timings[(int) (count($timings) / 2)] * 1000, end($timings) * 1000);
+}
+if($generated) {
+	unlink($path);
+}
+
+?>
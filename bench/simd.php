@@ -0,0 +1,53 @@
+<?php
+
+// Times av_stream_write_image() at 720p, 1080p and 4K. Frames go to uncompressed RGBA
+// so the gd-to-RGBA conversion isn't drowned out by the encoder. The script runs itself
+// once for each setting of av.simd--no SIMD, SSE2 only, then AVX2--so the kernels can
+// be compared on the same machine. The extension has to be loaded from php.ini for
+// the child processes to pick it up.
+//
+//   php bench/simd.php [frames]
+//   php -d av.simd=avx2 bench/simd.php [frames] --single
+
+$frame_count = isset($argv[1]) ? (int) $argv[1] : 60;
+$sizes = array("720p" => array(1280, 720), "1080p" => array(1920, 1080), "4K" => array(3840, 2160));
+
+if(!in_array("--single", $argv)) {
+	foreach(array("0", "sse2", "avx2") as $level) {
+		$command = escapeshellarg(PHP_BINARY) . " -d av.simd=$level " . escapeshellarg(__FILE__) . " $frame_count --single";
+		passthru($command);
+		echo "\n";
+	}
+	exit;
+}
+
+// the setting only caps the instruction set--report what was actually picked
+ob_start();
+phpinfo(INFO_MODULES);
+$kernels = preg_match('/Pixel conversion SIMD\s*=>\s*(\S+)/', strip_tags(ob_get_clean()), $m) ? $m[1] : "unknown";
+
+$path = sys_get_temp_dir() . "/av-bench-simd-" . getmypid() . ".nut";
+printf("av.simd=%s, kernels: %s, %d frames per size\n", ini_get("av.simd"), $kernels, $frame_count);
+foreach($sizes as $label => $size) {
+	list($width, $height) = $size;
+	$image = imagecreatetruecolor($width, $height);
+	imagealphablending($image, false);
+	for($y = 0; $y < $height; $y += 8) {
+		imagefilledrectangle($image, 0, $y, $width - 1, $y + 7, imagecolorallocatealpha($image, $y & 0xFF, 255 - ($y & 0xFF), 128, ($y >> 3) & 0x7F));
+	}
+
+	$file = av_file_open($path, "w");
+	$strm = av_stream_open($file, "video", array("codec" => "rawvideo", "pix_fmt" => "rgba", "width" => $width, "height" => $height, "frame_rate" => 24));
+	$start = microtime(true);
+	for($i = 0; $i < $frame_count; $i++) {
+		av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+	}
+	$elapsed = microtime(true) - $start;
+	av_file_close($file);
+	imagedestroy($image);
+
+	printf("%-6s %8.1f fps %8.2f ms/frame\n", $label, $frame_count / $elapsed, $elapsed * 1000 / $frame_count);
+}
+unlink($path);
+
+?>
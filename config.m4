@@ -159,7 +159,21 @@ if test "$PHP_AV" != "no"; then
     ])
   fi 
   
+  PHP_CHECK_LIBRARY(pthread,pthread_create,
+  [
+    PHP_ADD_LIBRARY(pthread,, AV_SHARED_LIBADD)
+  ],[
+  ],[
+  ])
+
+  PHP_CHECK_LIBRARY(rt,shm_open,
+  [
+    PHP_ADD_LIBRARY(rt,, AV_SHARED_LIBADD)
+  ],[
+  ],[
+  ])
+
   PHP_SUBST(AV_SHARED_LIBADD)
 
-  PHP_NEW_EXTENSION(av, av.c av_utils.c faststart.c, $ext_shared)
+  PHP_NEW_EXTENSION(av, av.c av_analysis.c av_simd.c av_utils.c faststart.c, $ext_shared)
 fi
@@ -56,17 +56,24 @@ extern zend_module_entry av_module_entry;
 #endif
 
 #include <libavcodec/avcodec.h>
+#include <libavcodec/avfft.h>
 #include <libavformat/avformat.h>
 #include <libavutil/mathematics.h>
 #include <libavutil/opt.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/pixfmt.h>
+#include <libavutil/time.h>
 #include <libswscale/swscale.h>
 #if defined(HAVE_SWRESAMPLE)
 #include <libswresample/swresample.h>
 #elif defined(HAVE_AVRESAMPLE)
 #include <libavresample/avresample.h>
 #endif
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(54, 7, 100)
+#include <libavutil/motion_vector.h>
+#define AV_MOTION_VECTORS_SUPPORTED
+#endif
 
 #if LIBAVUTIL_VERSION_MAJOR < 53
 #define AVPixelFormat				PixelFormat
@@ -82,8 +89,122 @@ extern zend_module_entry av_module_entry;
 	#define isnan				_isnan
 #endif
 
+#ifdef PHP_WIN32
+#include <windows.h>
+typedef HANDLE						av_thread;
+typedef CRITICAL_SECTION			av_mutex;
+typedef CONDITION_VARIABLE			av_cond;
+#define AV_THREAD_PROC(name, arg)	DWORD WINAPI name(LPVOID arg)
+#define AV_THREAD_RETURN			return 0
+typedef LPTHREAD_START_ROUTINE		av_thread_proc;
+#define AV_MEMORY_BARRIER()			MemoryBarrier()
+#else
+#include <pthread.h>
+typedef pthread_t					av_thread;
+typedef pthread_mutex_t				av_mutex;
+typedef pthread_cond_t				av_cond;
+#define AV_THREAD_PROC(name, arg)	void *name(void *arg)
+#define AV_THREAD_RETURN			return NULL
+typedef void *(*av_thread_proc)(void *);
+#define AV_MEMORY_BARRIER()			__sync_synchronize()
+#endif
+
 typedef struct av_file av_file;
 typedef struct av_stream av_stream;
+typedef struct av_scaler_key av_scaler_key;
+typedef struct av_scaler_slice av_scaler_slice;
+typedef struct av_slice_worker av_slice_worker;
+typedef struct av_slice_pool av_slice_pool;
+typedef struct av_shared_memory av_shared_memory;
+typedef struct av_shared_frame_header av_shared_frame_header;
+typedef struct av_shared_frame_slot av_shared_frame_slot;
+typedef struct av_shared_frame_ring av_shared_frame_ring;
+typedef struct av_loudness_meter av_loudness_meter;
+typedef struct av_waveform av_waveform;
+typedef struct av_fingerprinter av_fingerprinter;
+
+struct av_scaler_key {
+	int src_width;
+	int src_height;
+	enum AVPixelFormat src_pix_fmt;
+	int dst_width;
+	int dst_height;
+	enum AVPixelFormat dst_pix_fmt;
+	int flags;
+};
+
+struct av_scaler_slice {
+	struct SwsContext *scaler_cxt;
+	av_scaler_key key;					// dimensions of the slice, margins included
+	int src_y;							// first source row the scaler reads
+	int dst_y;							// first destination row the slice fills
+	int dst_rows;						// number of destination rows the slice fills
+	int margin;							// rows scaled above dst_y that are thrown away
+	uint8_t *buffer[4];					// the scaler's output, margins included
+	int buffer_stride[4];
+};
+
+struct av_slice_worker {
+	av_slice_pool *pool;
+	uint32_t index;
+	av_thread thread;
+};
+
+struct av_slice_pool {
+	uint32_t slice_count;
+	av_scaler_slice *slices;
+	av_scaler_key key;					// parameters of the whole-frame scaler the slices were created for
+	const AVPixFmtDescriptor *src_desc;
+	const AVPixFmtDescriptor *dst_desc;
+	int dst_bytewidth[4];
+
+	av_slice_worker *workers;			// one for each slice except the first, which the calling thread handles
+	uint32_t worker_count;
+	av_mutex mutex;
+	av_cond start;
+	av_cond done;
+	uint32_t generation;
+	uint32_t remaining;
+	int stop;
+
+	const uint8_t *src[4];				// the conversion currently in progress
+	int src_stride[4];
+	uint8_t *dst[4];
+	int dst_stride[4];
+};
+
+struct av_shared_memory {
+	uint8_t *base;
+	size_t size;
+#ifdef PHP_WIN32
+	HANDLE handle;
+#else
+	char *name;
+#endif
+};
+
+// layout of the shared memory frames are written into: the header is followed by the slot headers,
+// then at header_size the frame data, slot_size bytes per slot
+struct av_shared_frame_header {
+	uint32_t magic;						// AV_SHARED_FRAME_MAGIC
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t header_size;
+	uint64_t slot_size;
+	volatile uint64_t generation;		// generation of the last frame written
+};
+
+struct av_shared_frame_slot {
+	volatile uint64_t sequence;			// generation * 2 once the frame is complete, odd while it's being written
+	uint64_t reserved[7];
+};
+
+struct av_shared_frame_ring {
+	av_shared_memory memory;
+	av_shared_frame_header *header;
+	av_shared_frame_slot *slots;
+	uint64_t generation;
+};
 
 struct av_stream {
 	AVCodecContext *codec_cxt;
@@ -98,11 +219,26 @@ struct av_stream {
 
 	AVFrame *picture;					// RGBA picture
 	struct SwsContext *scaler_cxt;		// scaler context
+	av_scaler_key scaler_key;			// the parameters the scaler was created with
+	int scaler_flags;					// scaling algorithm and accuracy flags
+	uint32_t scaling_threads;			// number of slices to scale in parallel
+	av_slice_pool *slice_pool;
 
-	float *samples;						// PCM data after resampling
+	char *shared_memory_name;			// frames from av_stream_read_frame() go into a shared memory ring when set
+	uint32_t shared_memory_slot_count;
+	uint64_t shared_memory_slot_size;
+	av_shared_frame_ring *shared_frames;
+
+	uint8_t *samples;					// PCM data after resampling (planes follow one another when the format is planar)
 	uint32_t sample_count;				// the number of samples currently buffered
 	uint32_t sample_buffer_size;		// the number of samples in an audio frame
 	double sample_start_time;
+	enum AVSampleFormat pcm_sample_fmt;	// format of PCM data exchanged with PHP (AV_SAMPLE_FMT_NONE = same as codec)
+	int32_t pcm_sample_rate;			// 0 = same as codec
+	int32_t pcm_channels;				// 0 = same as codec
+	int64_t pcm_channel_layout;
+	uint32_t pcm_sample_size;			// bytes per sample of a single channel
+	int32_t pcm_passthrough;			// PCM data is in the codec's format and is copied without resampling
 #if defined(HAVE_SWRESAMPLE)
 	struct SwrContext *resampler_cxt;	// resampler context
 #elif defined(HAVE_AVRESAMPLE)
@@ -122,15 +258,19 @@ struct av_stream {
 	double next_subtitle_time;
 
 	AVPacket *packet;					// the current packet
-	AVPacket **packet_queue;			// packets for this stream waiting to be decoded or written to disk
-	uint32_t packet_queue_size;			// length of the queue
+	AVPacket **packet_queue;			// ring buffer of packets for this stream waiting to be decoded or written to disk
+	uint32_t packet_queue_size;			// capacity of the ring buffer (always a power of two)
+	uint32_t packet_queue_head;			// index of the oldest packet in the ring buffer
 	uint32_t packet_count;				// the number of packets in the queue
+	uint32_t packet_count_max;			// the highest number of packets ever held in the queue
+	uint32_t packet_queue_bytes;		// the total size of the packets in the queue
 	uint32_t packet_bytes_remaining;	// the number of bytes remaining in current packet (used during decoding only)
 
 	av_file *file;						// AV file containing this stream
 	uint32_t index;						// index of this stream
 
 	double time_sought;					// time passed to av_file_seek()
+	double roll_forward_end_time;		// time at which frames are decoded in full again after a precise seek
 
 	int32_t flags;
 };
@@ -140,6 +280,8 @@ enum {
 	AV_FILE_WRITE 						= 0x0002,
 	AV_FILE_APPEND						= 0x0004,
 
+	AV_FILE_PREFETCHING					= 0x0400,
+
 	AV_FILE_HEADER_ERROR_ENCOUNTERED	= 0x0800,
 	AV_FILE_EOF_REACHED					= 0x1000,
 	AV_FILE_HEADER_WRITTEN				= 0x2000,
@@ -148,14 +290,39 @@ enum {
 };
 
 enum {
+	AV_STREAM_KEYFRAMES_ONLY			= 0x0001,
+	AV_STREAM_TRUSTED_INPUT				= 0x0002,
+	AV_STREAM_EXPORTING_MOTION_VECTORS	= 0x0004,
+	AV_STREAM_FULL_ROLL_FORWARD			= 0x0008,
+
 	AV_STREAM_AUDIO_BUFFER_ALLOCATED	= 0x0400,
 	AV_STREAM_FRAME_BUFFER_ALLOCATED	= 0x0800,
 
+	AV_STREAM_ROLLING_FORWARD			= 0x0200,
+	AV_STREAM_DISCARDING				= 0x1000,
 	AV_STREAM_SOUGHT					= 0x2000,
 	AV_STREAM_FLUSHED					= 0x4000,
 	AV_STREAM_FREED						= 0x8000,
 };
 
+#define AV_PACKET_QUEUE_INITIAL_SIZE	32		// must be a power of two
+#define AV_PACKET_POOL_SIZE				64
+#define AV_PREFETCH_DEFAULT_SIZE		1024	// must be a power of two
+#define AV_SCALER_CACHE_DEFAULT_SIZE	16
+#define AV_SHARED_FRAME_MAGIC			0x4d535641	// "AVSM"
+#define AV_SHARED_FRAME_VERSION			1
+#define AV_SHARED_FRAME_DEFAULT_SLOTS	8
+#define AV_SHARED_MEMORY_EXISTS			-1		// returned by av_shared_memory_create() when the name is taken
+#define AV_PCM_DEFAULT_SAMPLE_RATE		44100
+#define AV_PCM_MAX_CHANNELS				8
+#define AV_LOUDNESS_DEFAULT_WINDOW		1.0
+#define AV_WAVEFORM_MAX_BUCKETS			1048576
+#define AV_FINGERPRINT_SAMPLE_RATE		11025
+#define AV_FINGERPRINT_FRAME_BITS		12
+#define AV_FINGERPRINT_FRAME_SIZE		(1 << AV_FINGERPRINT_FRAME_BITS)
+#define AV_FINGERPRINT_FRAME_STEP		(AV_FINGERPRINT_FRAME_SIZE / 3)
+#define AV_HASH_GRID_MAX_SIZE			32		// pHash works on a 32x32 grid, dHash on 9x8
+
 struct av_file {
 	AVFormatContext *format_cxt;
 	const AVInputFormat *input_format;
@@ -164,9 +331,94 @@ struct av_file {
 	av_stream **streams;
 	uint32_t stream_count;
 	uint32_t open_stream_count;
+
+	AVPacket **packet_pool;				// packet shells available for reuse
+	uint32_t packet_pool_count;			// the number of packets in the pool
+	uint32_t packet_pool_hits;			// the number of packets taken from the pool
+	uint32_t packet_pool_misses;		// the number of packets that had to be allocated
+
+	uint32_t discard_threshold;			// the queue size (in bytes) at which an idle stream is discarded
+
+	AVPacket *prefetch_queue;			// ring buffer of packets read ahead by the demux thread
+	uint32_t prefetch_queue_size;		// the maximum number of packets to read ahead
+	uint32_t prefetch_queue_head;		// index of the oldest packet in the ring buffer
+	uint32_t prefetch_count;			// the number of packets in the ring buffer
+	uint32_t prefetch_bytes;			// the total size of the packets in the ring buffer
+	uint32_t prefetch_byte_limit;		// the maximum number of bytes to read ahead (0 = no limit)
+	volatile int32_t prefetch_stop;		// tells the demux thread to exit
+	int32_t prefetch_pause;				// tells the demux thread to exit once the packet being read is queued
+	int32_t prefetch_eof;				// set by the demux thread when av_read_frame() fails
+	av_thread prefetch_thread;
+	av_mutex prefetch_mutex;
+	av_cond prefetch_not_empty;
+	av_cond prefetch_not_full;
+
 	int32_t flags;
 };
 
+// ITU-R BS.1770 loudness measurement, fed with interleaved float samples
+struct av_loudness_meter {
+	uint32_t channels;
+	uint32_t sample_rate;
+	double weights[AV_PCM_MAX_CHANNELS];
+	double shelf[5];					// b0, b1, b2, a1, a2 of the K-weighting stages
+	double highpass[5];
+	double filter_state[AV_PCM_MAX_CHANNELS][4];
+
+	// energies of 100ms sub-blocks, from which the gating blocks are formed
+	double *block_energies;
+	uint32_t block_count;
+	uint32_t block_capacity;
+	uint32_t block_length;
+	uint32_t block_position;
+	double block_energy;
+
+	float true_peak_history[AV_PCM_MAX_CHANNELS][12];
+	int32_t true_peak_enabled;
+	double sample_peak;
+	double true_peak;
+	double square_sum;
+	uint64_t sample_count;
+
+	zval *windows;
+	double window_start_time;
+	uint32_t window_length;
+	uint32_t window_position;
+	double window_peak;
+	double window_square_sum;
+	double window_energy;
+};
+
+// per-channel min/max (and optionally RMS) of a fixed number of buckets
+struct av_waveform {
+	uint32_t channels;
+	uint32_t bucket_count;
+	uint32_t samples_per_bucket;
+	uint32_t bucket_index;
+	uint32_t bucket_position;
+	float *mins;						// bucket_count * channels, interleaved
+	float *maxs;
+	double *square_sums;				// NULL when RMS isn't wanted
+	uint32_t *sample_counts;
+};
+
+// chroma-based audio fingerprint, fed with mono float samples at AV_FINGERPRINT_SAMPLE_RATE
+struct av_fingerprinter {
+	RDFTContext *rdft;
+	float *window;
+	float *frame;						// AV_FINGERPRINT_FRAME_SIZE samples, filled up then shifted by AV_FINGERPRINT_FRAME_STEP
+	float *spectrum;
+	uint32_t frame_fill;
+	double chroma_history[5][12];		// raw chroma of the most recent frames, for smoothing
+	uint32_t chroma_count;
+	double previous_chroma[12];
+	int32_t has_previous_chroma;
+	uint32_t *codes;
+	uint32_t code_count;
+	uint32_t code_capacity;
+	uint64_t sample_count;
+};
+
 int av_optimize_mov_file(AVIOContext *pb);
 
 int av_get_element_double(zval *array, const char *key, double *p_value);
@@ -182,6 +434,68 @@ void av_set_element_string(zval *array, const char *key, const char *value);
 void av_set_element_stringl(zval *array, const char *key, const char *value, long value_length);
 
 zval *av_create_gd_image(uint32_t width, uint32_t height TSRMLS_DC);
+zval *av_create_gd_truecolor_image(uint32_t width, uint32_t height TSRMLS_DC);
+
+typedef void (*av_gd_to_rgba_func)(uint8_t *dst, const int *src, uint32_t count);
+typedef void (*av_rgb32_to_gd_func)(int *dst, const uint32_t *src, uint32_t count, int has_alpha);
+typedef void (*av_copy_clamped_float_func)(float *dst, const float *src, uint32_t count);
+typedef void (*av_interleave_func)(uint8_t *dst, uint8_t * const *src, uint32_t channels, uint32_t sample_size, uint32_t count);
+typedef void (*av_deinterleave_func)(uint8_t * const *dst, const uint8_t *src, uint32_t channels, uint32_t sample_size, uint32_t count);
+typedef void (*av_accumulate_range_func)(const float *samples, uint32_t channels, uint32_t count, float *mins, float *maxs, double *square_sums);
+
+extern av_gd_to_rgba_func av_gd_to_rgba;
+extern av_rgb32_to_gd_func av_rgb32_to_gd;
+extern av_copy_clamped_float_func av_copy_clamped_float;
+extern av_interleave_func av_interleave_samples;
+extern av_deinterleave_func av_deinterleave_samples;
+extern av_accumulate_range_func av_accumulate_range;
+
+void av_gd_to_rgba_c(uint8_t *dst, const int *src, uint32_t count);
+void av_rgb32_to_gd_c(int *dst, const uint32_t *src, uint32_t count, int has_alpha);
+void av_copy_clamped_float_c(float *dst, const float *src, uint32_t count);
+void av_interleave_samples_c(uint8_t *dst, uint8_t * const *src, uint32_t channels, uint32_t sample_size, uint32_t count);
+void av_deinterleave_samples_c(uint8_t * const *dst, const uint8_t *src, uint32_t channels, uint32_t sample_size, uint32_t count);
+void av_accumulate_range_c(const float *samples, uint32_t channels, uint32_t count, float *mins, float *maxs, double *square_sums);
+void av_init_simd(const char *level_name);
+const char *av_get_simd_name(void);
+
+int av_thread_create(av_thread *thread, av_thread_proc proc, void *arg);
+void av_thread_join(av_thread thread);
+void av_mutex_init(av_mutex *mutex);
+void av_mutex_destroy(av_mutex *mutex);
+void av_mutex_lock(av_mutex *mutex);
+void av_mutex_unlock(av_mutex *mutex);
+void av_cond_init(av_cond *cond);
+void av_cond_destroy(av_cond *cond);
+void av_cond_wait(av_cond *cond, av_mutex *mutex);
+void av_cond_signal(av_cond *cond);
+void av_cond_broadcast(av_cond *cond);
+
+int av_shared_memory_create(av_shared_memory *shm, const char *name, size_t size);
+void av_shared_memory_destroy(av_shared_memory *shm);
+
+av_loudness_meter *av_create_loudness_meter(uint32_t channels, uint32_t sample_rate, uint64_t channel_layout, double window_duration, double start_time, int true_peak);
+void av_add_loudness_samples(av_loudness_meter *meter, const float *samples, uint32_t count);
+void av_get_loudness_results(av_loudness_meter *meter, zval *result);
+void av_free_loudness_meter(av_loudness_meter *meter);
+
+av_waveform *av_create_waveform(uint32_t channels, uint32_t bucket_count, uint32_t samples_per_bucket, int rms);
+void av_add_waveform_samples(av_waveform *waveform, const float *samples, uint32_t count);
+void av_set_waveform_bucket(av_waveform *waveform, uint32_t index);
+void av_get_waveform_results(av_waveform *waveform, zval *result, int binary);
+void av_free_waveform(av_waveform *waveform);
+
+av_fingerprinter *av_create_fingerprinter(void);
+void av_add_fingerprint_samples(av_fingerprinter *fp, const float *samples, uint32_t count);
+void av_get_fingerprint_results(av_fingerprinter *fp, zval *result, int binary);
+void av_free_fingerprinter(av_fingerprinter *fp);
+
+void av_reduce_luma_plane(const uint8_t *plane, int linesize, int width, int height, uint8_t *grid, int grid_width, int grid_height);
+uint64_t av_compute_dhash(const uint8_t *grid);
+uint64_t av_compute_phash(const uint8_t *grid);
+
+int av_compute_mean_qp(AVFrame *frame, int width, int height, double *p_qp);
+int av_summarize_motion_vectors(AVFrame *frame, double *p_magnitude, long *p_count);
 
 PHP_MINIT_FUNCTION(av);
 PHP_MSHUTDOWN_FUNCTION(av);
@@ -195,13 +509,22 @@ PHP_FUNCTION(av_file_seek);
 PHP_FUNCTION(av_file_eof);
 PHP_FUNCTION(av_file_stat);
 PHP_FUNCTION(av_file_optimize);
+PHP_FUNCTION(av_file_extract_thumbnails);
 
 PHP_FUNCTION(av_stream_open);
 PHP_FUNCTION(av_stream_close);
 PHP_FUNCTION(av_stream_read_image);
+PHP_FUNCTION(av_stream_read_images);
+PHP_FUNCTION(av_stream_read_frame);
 PHP_FUNCTION(av_stream_read_pcm);
 PHP_FUNCTION(av_stream_read_subtitle);
+PHP_FUNCTION(av_stream_analyze_audio);
+PHP_FUNCTION(av_stream_waveform);
+PHP_FUNCTION(av_stream_fingerprint);
+PHP_FUNCTION(av_stream_hash_frames);
+PHP_FUNCTION(av_stream_read_frame_info);
 PHP_FUNCTION(av_stream_write_image);
+PHP_FUNCTION(av_stream_write_frame);
 PHP_FUNCTION(av_stream_write_pcm);
 PHP_FUNCTION(av_stream_write_subtitle);
 
@@ -219,6 +542,8 @@ ZEND_BEGIN_MODULE_GLOBALS(av)
 	long threads_per_audio_stream;
 	zend_bool optimize_output;
 	zend_bool verbose_reporting;
+	long scaler_cache_size;
+	char *simd;
 ZEND_END_MODULE_GLOBALS(av)
 
 #ifdef ZTS
@@ -0,0 +1,50 @@
+--TEST--
+Audio analysis test
+--SKIPIF--
+<?php
+	if(!in_array('flac', av_get_encoders())) print 'skip FLAC encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-analyze-audio.flac";
+
+// five seconds of a 997Hz tone at -20dBFS
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "audio", array("sampling_rate" => 48000, "channels" => 2, "pcm_sample_rate" => 48000));
+$samples = '';
+for($i = 0; $i < 48000 * 5; $i++) {
+	$value = sin($i * 997 * 2 * M_PI / 48000) * 0.1;
+	$samples .= pack("ff", $value, $value);
+}
+av_stream_write_pcm($strm, $samples);
+av_file_close($file);
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "audio");
+$result = av_stream_analyze_audio($strm, array("window_duration" => 1.0));
+av_file_close($file);
+
+if(abs($result['integrated_loudness'] + 20) > 1) {
+	echo "Integrated loudness: {$result['integrated_loudness']}\n";
+}
+if($result['loudness_range'] > 1) {
+	echo "Loudness range: {$result['loudness_range']}\n";
+}
+if(abs($result['sample_peak'] + 20) > 0.5 || $result['true_peak'] < $result['sample_peak'] || $result['true_peak'] > -19) {
+	echo "Peaks: {$result['sample_peak']} {$result['true_peak']}\n";
+}
+if(abs($result['rms'] + 23) > 0.5) {
+	echo "RMS: {$result['rms']}\n";
+}
+if(count($result['windows']) < 5 || count($result['windows']) > 6) {
+	echo "Windows: " . count($result['windows']) . "\n";
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,47 @@
+--TEST--
+B-frame encoding test
+--SKIPIF--
+<?php
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-b-frames.mp4";
+
+foreach(array(0, 2) as $b_frames) {
+	$file = av_file_open($path, "w");
+	$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24, "gop" => 12, "b_frames" => $b_frames));
+	$image = imagecreatetruecolor(320, 240);
+	for($i = 0; $i < 24; $i++) {
+		imagefilledrectangle($image, 0, 0, 319, 239, imagecolorallocate($image, 20, 40, 80));
+		imagefilledrectangle($image, $i * 8, 80, $i * 8 + 79, 159, imagecolorallocate($image, 240, 200, 40));
+		av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+	}
+	av_file_close($file);
+
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "video");
+	$frames = av_stream_read_frame_info($strm);
+	av_file_close($file);
+
+	// frames come out in display order whether or not they were reordered
+	$types = '';
+	$previous = -1;
+	foreach($frames as $frame) {
+		$types .= $frame['type'];
+		if($frame['time'] <= $previous) {
+			echo "$b_frames: frame at $frame[time] follows $previous\n";
+		}
+		$previous = $frame['time'];
+	}
+	echo "$b_frames: " . count($frames) . " frames, " . (strpos($types, "B") !== false ? "with" : "without") . " B-frames\n";
+}
+unlink($path);
+
+?>
+--EXPECT--
+0: 24 frames, without B-frames
+2: 24 frames, with B-frames
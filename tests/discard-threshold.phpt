@@ -0,0 +1,52 @@
+--TEST--
+Discard threshold test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+require("helpers.php");
+
+$folder = dirname(__FILE__);
+$filename = "test-discard-threshold.mp4";
+
+$testVideo = new TestVideo("$folder/$filename", 320, 240, 24, 4.0);
+$testVideo->create();
+
+function get_audio_queue_length($file) {
+	$stat = av_file_stat($file);
+	foreach($stat['streams'] as $stream) {
+		if($stream['type'] == "audio") {
+			return $stream['packet_queue_length'];
+		}
+	}
+	return null;
+}
+
+// read two seconds of video while the audio stream sits idle
+$image = imagecreatetruecolor(320, 240);
+foreach(array(0, 4096) as $threshold) {
+	$file = av_file_open("$folder/$filename", "r", array("discard_threshold" => $threshold));
+	$video = av_stream_open($file, "video");
+	$audio = av_stream_open($file, "audio");
+	for($i = 0; $i < 48; $i++) {
+		av_stream_read_image($video, $image, $time);
+	}
+	$length = get_audio_queue_length($file);
+	echo "$threshold: " . (($length > 0) ? "audio queued" : "audio discarded") . "\n";
+
+	// reading the stream again turns queuing back on
+	var_dump(av_stream_read_pcm($audio, $data, $time));
+	av_file_close($file);
+}
+unlink("$folder/$filename");
+
+?>
+--EXPECT--
+0: audio queued
+bool(true)
+4096: audio discarded
+bool(true)
@@ -0,0 +1,90 @@
+--TEST--
+Audio fingerprint test
+--SKIPIF--
+<?php
+	if(!in_array('flac', av_get_encoders())) print 'skip FLAC encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+
+function create_melody($path, $notes, $sample_rate) {
+	$file = av_file_open($path, "w");
+	$strm = av_stream_open($file, "audio", array("sampling_rate" => $sample_rate, "channels" => 2, "pcm_sample_rate" => $sample_rate));
+	$samples = '';
+	foreach($notes as $note) {
+		$frequency = 440 * pow(2, $note / 12);
+		for($i = 0; $i < $sample_rate / 2; $i++) {
+			$value = sin($i * $frequency * 2 * M_PI / $sample_rate) * 0.3;
+			$samples .= pack("ff", $value, $value);
+		}
+	}
+	av_stream_write_pcm($strm, $samples);
+	av_file_close($file);
+}
+
+function fingerprint($path, $options = array()) {
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "audio");
+	$result = av_stream_fingerprint($strm, $options);
+	av_file_close($file);
+	return $result;
+}
+
+function bit_error_rate($a, $b) {
+	$count = min(count($a), count($b));
+	$errors = 0;
+	for($i = 0; $i < $count; $i++) {
+		// compare the hex codes 16 bits at a time so this works with 32-bit integers
+		for($offset = 0; $offset < 8; $offset += 4) {
+			$x = hexdec(substr($a[$i], $offset, 4)) ^ hexdec(substr($b[$i], $offset, 4));
+			for(; $x; $x >>= 1) {
+				$errors += $x & 1;
+			}
+		}
+	}
+	return $errors / ($count * 32);
+}
+
+$melody = array(0, 4, 7, 12, 7, 4, 0, 2, 5, 9, 5, 2, 0, 4, 7, 12);
+create_melody("$folder/test-fingerprint-a.flac", $melody, 44100);
+create_melody("$folder/test-fingerprint-b.flac", $melody, 48000);
+create_melody("$folder/test-fingerprint-c.flac", array_reverse($melody), 44100);
+
+$a = fingerprint("$folder/test-fingerprint-a.flac");
+$b = fingerprint("$folder/test-fingerprint-b.flac");
+$c = fingerprint("$folder/test-fingerprint-c.flac");
+$short = fingerprint("$folder/test-fingerprint-a.flac", array("duration" => 3, "binary" => true));
+
+if(count($a['codes']) < 50) {
+	echo "Too few codes: " . count($a['codes']) . "\n";
+}
+if(bit_error_rate($a['codes'], $b['codes']) > 0.15) {
+	echo "Same audio differs: " . bit_error_rate($a['codes'], $b['codes']) . "\n";
+}
+if(bit_error_rate($a['codes'], $c['codes']) < 0.25) {
+	echo "Different audio matches: " . bit_error_rate($a['codes'], $c['codes']) . "\n";
+}
+if(abs($short['duration'] - 3) > 0.01) {
+	echo "Duration: {$short['duration']}\n";
+}
+$short_codes = array();
+foreach(str_split($short['codes'], 4) as $code) {
+	$short_codes[] = bin2hex(strrev($code));
+}
+if(count($a['codes']) != 0 && !preg_match('/^[0-9a-f]{8}$/', $a['codes'][0])) {
+	echo "Bad code: {$a['codes'][0]}\n";
+}
+if(array_slice($a['codes'], 0, count($short_codes)) != $short_codes) {
+	echo "Truncated fingerprint mismatch\n";
+}
+unlink("$folder/test-fingerprint-a.flac");
+unlink("$folder/test-fingerprint-b.flac");
+unlink("$folder/test-fingerprint-c.flac");
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,95 @@
+--TEST--
+Perceptual frame hash test
+--SKIPIF--
+<?php
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-frame-hash.mp4";
+
+// one second of horizontal bands followed by one second of vertical bands
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24, "gop" => 12));
+$image = imagecreatetruecolor(320, 240);
+for($i = 0; $i < 48; $i++) {
+	for($j = 0; $j < 8; $j++) {
+		$color = imagecolorallocate($image, $j * 32, $j * 32, $j * 32);
+		if($i < 24) {
+			imagefilledrectangle($image, 0, $j * 30, 319, $j * 30 + 29, $color);
+		} else {
+			imagefilledrectangle($image, 280 - $j * 40, 0, 319 - $j * 40, 239, $color);
+		}
+	}
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+
+function hamming($a, $b) {
+	$distance = 0;
+	for($i = 0; $i < 16; $i += 4) {
+		$x = hexdec(substr($a, $i, 4)) ^ hexdec(substr($b, $i, 4));
+		for(; $x; $x >>= 1) {
+			$distance += $x & 1;
+		}
+	}
+	return $distance;
+}
+
+foreach(array("dhash", "phash") as $algorithm) {
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "video");
+	$hashes = av_stream_hash_frames($strm, array("algorithm" => $algorithm));
+	av_file_close($file);
+	if(count($hashes) != 48) {
+		echo "$algorithm: " . count($hashes) . " hashes\n";
+	}
+	$same = hamming($hashes[2]['hash'], $hashes[20]['hash']);
+	$different = hamming($hashes[2]['hash'], $hashes[40]['hash']);
+	if($same > 6 || $different < 16) {
+		echo "$algorithm: same = $same, different = $different\n";
+	}
+}
+
+// scanning key frames only should give the hashes of the frames at each GOP boundary
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video");
+$all_hashes = av_stream_hash_frames($strm);
+av_file_close($file);
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video", array("keyframes_only" => true));
+$hashes = av_stream_hash_frames($strm);
+av_file_close($file);
+if(count($hashes) != 4) {
+	echo "keyframes_only: " . count($hashes) . " hashes\n";
+}
+foreach($hashes as $index => $entry) {
+	$expected = $all_hashes[$index * 12];
+	if($entry['time'] != $expected['time'] || $entry['hash'] != $expected['hash']) {
+		echo "keyframes_only: got $entry[hash] at $entry[time] instead of $expected[hash] at $expected[time]\n";
+	}
+}
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video", array("keyframes_only" => true));
+$hashes = av_stream_hash_frames($strm, array("interval" => 2, "count" => 1));
+av_file_close($file);
+if(count($hashes) != 1 || strlen($hashes[0]['hash']) != 16) {
+	print_r($hashes);
+}
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video");
+av_stream_hash_frames($strm, array("algorithm" => "ahash"));
+av_file_close($file);
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECTF--
+Warning: av_stream_hash_frames(): 'ahash' is not a recognized hashing algorithm in %s on line %d
+OK
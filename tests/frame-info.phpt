@@ -0,0 +1,64 @@
+--TEST--
+Frame info test
+--SKIPIF--
+<?php
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-frame-info.mp4";
+
+// a box moving steadily across the frame
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24, "gop" => 12));
+$image = imagecreatetruecolor(320, 240);
+for($i = 0; $i < 24; $i++) {
+	imagefilledrectangle($image, 0, 0, 319, 239, imagecolorallocate($image, 20, 40, 80));
+	imagefilledrectangle($image, $i * 8, 80, $i * 8 + 79, 159, imagecolorallocate($image, 240, 200, 40));
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video");
+$frames = av_stream_read_frame_info($strm);
+av_file_close($file);
+if(count($frames) != 24) {
+	echo count($frames) . " frames\n";
+}
+$key_frames = 0;
+foreach($frames as $frame) {
+	if($frame['size'] <= 0 || !in_array($frame['type'], array("I", "P", "B"))) {
+		print_r($frame);
+	}
+	if($frame['key_frame']) {
+		$key_frames++;
+	}
+}
+if($frames[0]['type'] != "I" || $key_frames != 2) {
+	echo "first frame: {$frames[0]['type']}, $key_frames key frames\n";
+}
+
+// motion vectors are only available when libavcodec can export them
+$file = av_file_open($path, "r");
+$strm = @av_stream_open($file, "video", array("export_motion_vectors" => true));
+$frames = av_stream_read_frame_info($strm, array("count" => 6));
+av_file_close($file);
+if(count($frames) != 6) {
+	echo count($frames) . " frames\n";
+}
+if(isset($frames[0]['motion'])) {
+	if($frames[0]['motion_vectors'] != 0 || $frames[3]['motion_vectors'] == 0 || $frames[3]['motion'] <= 0) {
+		print_r($frames);
+	}
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
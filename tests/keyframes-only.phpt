@@ -0,0 +1,41 @@
+--TEST--
+Key frames only test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-keyframes-only.mp4";
+
+// write four seconds with a key frame every half second
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24, "gop" => 12));
+$image = imagecreatetruecolor(320, 240);
+for($i = 0; $i < 24 * 4; $i++) {
+	imagefilledrectangle($image, 0, 0, 320, 240, imagecolorallocate($image, 0, 0, 128));
+	imagefilledrectangle($image, $i * 2, 100, $i * 2 + 39, 139, imagecolorallocate($image, 255, 255, 255));
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video", array("keyframes_only" => true));
+$count = 0;
+while(av_stream_read_image($strm, $image, $time)) {
+	$index = round($time * 24 - 0.5);
+	if($index % 12 != 0) {
+		echo "Frame at $time is not at a GOP boundary\n";
+	}
+	$count++;
+}
+echo "$count\n";
+av_file_close($file);
+unlink($path);
+
+?>
+--EXPECT--
+8
@@ -0,0 +1,44 @@
+--TEST--
+Packet pool test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+require("helpers.php");
+
+$folder = dirname(__FILE__);
+$filename = "test-packet-pool.mp4";
+
+$testVideo = new TestVideo("$folder/$filename", 320, 240, 24, 2.0);
+$testVideo->setAudioCodec(false);
+$testVideo->create();
+
+$file = av_file_open("$folder/$filename", "r");
+$strm = av_stream_open($file, "video");
+$stat = av_file_stat($file);
+var_dump($stat['packet_pool_hits'], $stat['packet_pool_misses']);
+
+// each packet goes back to the pool once it's decoded, so only the first few need allocating
+$image = imagecreatetruecolor(320, 240);
+$count = 0;
+while(av_stream_read_image($strm, $image, $time)) {
+	$count++;
+}
+$stat = av_file_stat($file);
+var_dump($count > 40);
+var_dump($stat['packet_pool_misses'] > 0 && $stat['packet_pool_misses'] < 8);
+var_dump($stat['packet_pool_hits'] + $stat['packet_pool_misses'] >= $count);
+av_file_close($file);
+unlink("$folder/$filename");
+
+?>
+--EXPECT--
+int(0)
+int(0)
+bool(true)
+bool(true)
+bool(true)
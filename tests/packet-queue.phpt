@@ -0,0 +1,55 @@
+--TEST--
+Packet queue statistics test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+require("helpers.php");
+
+$folder = dirname(__FILE__);
+$filename = "test-packet-queue.mp4";
+
+$testVideo = new TestVideo("$folder/$filename", 320, 240, 24, 2.0);
+$testVideo->create();
+
+function get_queue($file, $type) {
+	$stat = av_file_stat($file);
+	foreach($stat['streams'] as $stream) {
+		if($stream['type'] == $type) {
+			return $stream;
+		}
+	}
+	return null;
+}
+
+// read only the video, so the audio packets pile up in their queue
+$file = av_file_open("$folder/$filename", "r");
+$video = av_stream_open($file, "video");
+$audio = av_stream_open($file, "audio");
+$image = imagecreatetruecolor(320, 240);
+while(av_stream_read_image($video, $image, $time));
+$queue = get_queue($file, "audio");
+var_dump($queue['packet_queue_length'] > 32);
+var_dump($queue['packet_queue_peak'] >= $queue['packet_queue_length']);
+// the capacity is a power of two large enough for the peak
+var_dump($queue['packet_queue_size'] >= $queue['packet_queue_peak'] && ($queue['packet_queue_size'] & ($queue['packet_queue_size'] - 1)) == 0);
+$peak = $queue['packet_queue_peak'];
+
+// draining the queue leaves the peak alone
+while(av_stream_read_pcm($audio, $data, $time));
+$queue = get_queue($file, "audio");
+var_dump($queue['packet_queue_length'], $queue['packet_queue_peak'] == $peak);
+av_file_close($file);
+unlink("$folder/$filename");
+
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+int(0)
+bool(true)
@@ -0,0 +1,65 @@
+--TEST--
+Aggregated PCM read test
+--SKIPIF--
+<?php
+	if(!in_array('flac', av_get_encoders())) print 'skip FLAC encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-pcm-aggregate.flac";
+
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "audio", array("sampling_rate" => 44100, "channels" => 2, "pcm_format" => "s16"));
+$samples = '';
+for($i = 0; $i < 44100 * 3; $i++) {
+	$value = (int) (sin($i * 330 * 2 * M_PI / 44100) * 12000);
+	$samples .= pack("ss", $value, -$value);
+}
+av_stream_write_pcm($strm, $samples);
+av_file_close($file);
+
+// read one frame at a time
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "audio", array("pcm_format" => "s16"));
+$single = '';
+$single_calls = 0;
+while(av_stream_read_pcm($strm, $data, $time)) {
+	$single .= $data;
+	$single_calls++;
+}
+av_file_close($file);
+
+// read at least half a second at a time
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "audio", array("pcm_format" => "s16"));
+$aggregated = '';
+$aggregated_calls = 0;
+$last_time = -1;
+while(av_stream_read_pcm($strm, $data, $time, array("min_duration" => 0.5))) {
+	if($time <= $last_time) {
+		echo "Time did not advance: $time\n";
+	}
+	if(strlen($data) < 44100 * 0.5 * 4 && $aggregated_calls < 5) {
+		echo "Short buffer: " . strlen($data) . "\n";
+	}
+	$last_time = $time;
+	$aggregated .= $data;
+	$aggregated_calls++;
+}
+av_file_close($file);
+
+if($aggregated !== $single) {
+	echo "Data mismatch\n";
+}
+if($aggregated_calls > 7 || $aggregated_calls >= $single_calls) {
+	echo "$aggregated_calls calls versus $single_calls\n";
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,70 @@
+--TEST--
+PCM clamping test
+--SKIPIF--
+<?php
+	if(!in_array('flac', av_get_encoders())) print 'skip FLAC encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-pcm-clamp.flac";
+
+// float samples outside [-1, 1] are clamped, with NaN becoming 1
+$values = array(0.5, -0.25, 2.5, -3.0, INF, -INF, NAN, 0.0);
+$expected = array(0.5, -0.25, 1.0, -1.0, 1.0, -1.0, 1.0, 0.0);
+
+function write_samples($path, $values, $options) {
+	$file = av_file_open($path, "w");
+	$strm = av_stream_open($file, "audio", $options + array("sampling_rate" => 48000, "channels" => 2, "pcm_format" => "flt", "pcm_sample_rate" => 48000, "pcm_channels" => 2));
+	$chunk = '';
+	foreach($values as $value) {
+		$chunk .= pack("f", $value);
+	}
+	// use odd lengths so both the vector loop and the tail get exercised
+	av_stream_write_pcm($strm, str_repeat($chunk, 3001) . pack("ff", $values[2], $values[6]));
+	av_stream_write_pcm($strm, str_repeat($chunk, 2999));
+	av_file_close($file);
+}
+
+function check_samples($label, $path, $expected) {
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "audio", array("pcm_format" => "flt", "pcm_sample_rate" => 0, "pcm_channels" => 0));
+	$data = '';
+	while(av_stream_read_pcm($strm, $buffer, $time)) {
+		$data .= $buffer;
+	}
+	av_file_close($file);
+	$samples = array_values(unpack("f*", $data));
+	if(count($samples) != 6000 * count($expected) + 2) {
+		echo "$label: " . count($samples) . " samples\n";
+	}
+	// the two extra samples sit at the end of the first write
+	$extra = 3001 * count($expected);
+	foreach($samples as $index => $sample) {
+		if($index >= $extra && $index < $extra + 2) {
+			$value = 1.0;
+		} else {
+			$value = $expected[(($index > $extra) ? $index - 2 : $index) % count($expected)];
+		}
+		if(!($sample >= -1.0 && $sample <= 1.0) || abs($sample - $value) > 0.001) {
+			echo "$label: sample $index is $sample instead of $value\n";
+			break;
+		}
+	}
+}
+
+write_samples($path, $values, array());
+check_samples("clamped", $path, $expected);
+
+// in-range samples are copied as is with trusted_input
+write_samples($path, $expected, array("trusted_input" => true));
+check_samples("trusted_input", $path, $expected);
+
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,108 @@
+--TEST--
+PCM sample format test
+--SKIPIF--
+<?php
+	if(!in_array('flac', av_get_encoders())) print 'skip FLAC encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-pcm-format.flac";
+
+// write one second of stereo 16-bit audio at 48KHz, with the right channel inverted
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "audio", array("sampling_rate" => 48000, "channels" => 2, "pcm_format" => "s16", "pcm_sample_rate" => 48000, "pcm_channels" => 2));
+$samples = '';
+$expected = array();
+for($i = 0; $i < 48000; $i++) {
+	$value = (int) (sin($i * 440 * 2 * M_PI / 48000) * 16000);
+	$samples .= pack("ss", $value, -$value);
+	$expected[] = $value;
+}
+av_stream_write_pcm($strm, $samples);
+av_file_close($file);
+
+// return the samples of each channel, scaled to 16-bit range
+function read_channels($path, $options) {
+	$codes = array("s16" => "s", "s32" => "l", "flt" => "f", "dbl" => "d");
+	$scales = array("s16" => 1, "s32" => 1 / 65536, "flt" => 32768, "dbl" => 32768);
+	$format = $options["pcm_format"];
+	$packed_format = ($format == "native") ? "s16" : packed_format($format);
+	$channels = array(array(), array());
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "audio", $options + array("pcm_sample_rate" => 0, "pcm_channels" => 0));
+	while(av_stream_read_pcm($strm, $data, $time)) {
+		$values = array_values(unpack($codes[$packed_format] . "*", $data));
+		$count = count($values) / 2;
+		for($i = 0; $i < $count; $i++) {
+			if($packed_format != $format && $format != "native") {
+				// planar: the channels follow one another
+				$channels[0][] = $values[$i] * $scales[$packed_format];
+				$channels[1][] = $values[$count + $i] * $scales[$packed_format];
+			} else {
+				$channels[0][] = $values[$i * 2] * $scales[$packed_format];
+				$channels[1][] = $values[$i * 2 + 1] * $scales[$packed_format];
+			}
+		}
+	}
+	av_file_close($file);
+	return $channels;
+}
+
+function packed_format($format) {
+	return (substr($format, -1) == "p") ? substr($format, 0, -1) : $format;
+}
+
+// read it back in a number of formats, without conversion of the rate
+foreach(array("native", "s16", "s32", "flt", "dbl", "s16p", "fltp") as $format) {
+	$channels = read_channels($path, array("pcm_format" => $format));
+	if(count($channels[0]) != 48000) {
+		echo "$format: " . count($channels[0]) . " samples\n";
+		continue;
+	}
+	foreach($expected as $index => $value) {
+		if(abs($channels[0][$index] - $value) > 0.01 || abs($channels[1][$index] + $value) > 0.01) {
+			echo "$format: sample $index is {$channels[0][$index]}/{$channels[1][$index]} instead of $value/" . -$value . "\n";
+			break;
+		}
+	}
+}
+
+// resample to 24KHz: the tone should keep its level and pitch
+$channels = read_channels($path, array("pcm_format" => "flt", "pcm_sample_rate" => 24000));
+$count = count($channels[0]);
+if(abs($count - 24000) > 240) {
+	echo "24KHz: $count samples\n";
+}
+$square_sum = 0;
+$crossings = 0;
+for($i = 1; $i < $count; $i++) {
+	$square_sum += $channels[0][$i] * $channels[0][$i];
+	if(($channels[0][$i] < 0) != ($channels[0][$i - 1] < 0)) {
+		$crossings++;
+	}
+	if(abs($channels[0][$i] + $channels[1][$i]) > 1) {
+		echo "24KHz: channels differ at sample $i\n";
+		break;
+	}
+}
+$rms = sqrt($square_sum / $count);
+if(abs($rms - 16000 / sqrt(2)) > 16000 * 0.03) {
+	echo "24KHz: RMS is $rms\n";
+}
+if(abs($crossings - 880) > 4) {
+	echo "24KHz: $crossings zero crossings\n";
+}
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "audio", array("pcm_format" => "s17"));
+av_file_close($file);
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECTF--
+Warning: av_stream_open(): Invalid sample format 's17' in %s on line %d
+OK
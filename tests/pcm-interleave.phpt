@@ -0,0 +1,74 @@
+--TEST--
+PCM interleave round-trip test
+--SKIPIF--
+<?php
+	if(!in_array('alac', av_get_encoders())) print 'skip ALAC encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-pcm-interleave.m4a";
+
+// ALAC is lossless and works with planar samples, so whatever is written has to come back
+// unchanged after being split into planes on the way in and merged on the way out
+foreach(array(1, 2) as $channels) {
+	$planes = array_fill(0, $channels, array());
+	$interleaved = '';
+	for($i = 0; $i < 44100 + 7; $i++) {
+		for($c = 0; $c < $channels; $c++) {
+			$value = (($i * 7919 + $c * 104729) % 65536) - 32768;
+			$planes[$c][] = $value;
+			$interleaved .= pack("s", $value);
+		}
+	}
+
+	$file = av_file_open($path, "w");
+	$strm = av_stream_open($file, "audio", array("codec" => "alac", "sampling_rate" => 44100, "channels" => $channels, "pcm_format" => "s16", "pcm_sample_rate" => 44100, "pcm_channels" => $channels));
+	av_stream_write_pcm($strm, $interleaved);
+	av_file_close($file);
+
+	// packed, matching what was written
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "audio", array("pcm_format" => "s16", "pcm_sample_rate" => 0, "pcm_channels" => 0));
+	$data = '';
+	while(av_stream_read_pcm($strm, $buffer, $time)) {
+		$data .= $buffer;
+	}
+	av_file_close($file);
+	if($data !== $interleaved) {
+		echo "$channels channel(s): packed samples differ\n";
+	}
+
+	// planar, each returned string holding the channels one after the other
+	$file = av_file_open($path, "r");
+	$strm = @av_stream_open($file, "audio", array("pcm_format" => "s16p", "pcm_sample_rate" => 0, "pcm_channels" => 0));
+	if(!$strm) {
+		// builds without libswresample or libavresample only hand out packed samples
+		av_file_close($file);
+		continue;
+	}
+	$offset = 0;
+	while(av_stream_read_pcm($strm, $buffer, $time)) {
+		$values = array_values(unpack("s*", $buffer));
+		$count = count($values) / $channels;
+		for($c = 0; $c < $channels; $c++) {
+			if(array_slice($values, $c * $count, $count) != array_slice($planes[$c], $offset, $count)) {
+				echo "$channels channel(s): planar samples differ at $offset\n";
+				break 2;
+			}
+		}
+		$offset += $count;
+	}
+	av_file_close($file);
+	if($offset != count($planes[0])) {
+		echo "$channels channel(s): $offset planar samples\n";
+	}
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,65 @@
+--TEST--
+Precise seek test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-precise-seek.mp4";
+
+// write a file with long GOPs so a seek has to decode forward from a key frame,
+// with B-frames that can be skipped on the way
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24, "gop" => 48, "b_frames" => 2));
+$image = imagecreatetruecolor(320, 240);
+for($i = 0; $i < 24 * 6; $i++) {
+	$color = imagecolorallocate($image, $i, 255 - $i, 0);
+	imagefilledrectangle($image, 0, 0, 320, 240, $color);
+	imagefilledrectangle($image, $i * 2, 100, $i * 2 + 39, 139, imagecolorallocate($image, 255, 255, 255));
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+
+function sample($image) {
+	$pixels = array();
+	for($y = 4; $y < 240; $y += 8) {
+		for($x = 4; $x < 320; $x += 8) {
+			$pixels[] = imagecolorat($image, $x, $y);
+		}
+	}
+	return $pixels;
+}
+
+// seeking with non-reference frames skipped has to give the same frames as decoding all of them
+$results = array();
+foreach(array(true, false) as $fast_seek) {
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "video", array("fast_seek" => $fast_seek));
+	foreach(array(1.0, 3.5, 5.2, 2.25) as $target) {
+		av_file_seek($file, $target);
+		av_stream_read_image($strm, $image, $time);
+		if($time > $target || $target - $time > 1 / 24) {
+			echo "Seek to $target landed at $time\n";
+		}
+		$results[$fast_seek][] = array($time, sample($image));
+	}
+	av_file_close($file);
+}
+foreach($results[true] as $index => $result) {
+	if($result[0] != $results[false][$index][0]) {
+		echo "Seek $index: $result[0] instead of {$results[false][$index][0]}\n";
+	} else if($result[1] != $results[false][$index][1]) {
+		echo "Seek $index: frame differs\n";
+	}
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,65 @@
+--TEST--
+Prefetch test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-prefetch.mp4";
+
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24, "gop" => 24));
+$image = imagecreatetruecolor(320, 240);
+for($i = 0; $i < 24 * 4; $i++) {
+	$color = imagecolorallocate($image, $i * 2, 255 - $i * 2, 0);
+	imagefilledrectangle($image, 0, 0, 320, 240, $color);
+	imagefilledrectangle($image, $i * 3, 100, $i * 3 + 39, 139, imagecolorallocate($image, 255, 255, 255));
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+
+function read_frames($options) {
+	global $path;
+	$frames = array();
+	$file = av_file_open($path, "r", $options);
+	$strm = av_stream_open($file, "video");
+	$image = imagecreatetruecolor(320, 240);
+	// read part of the file, seek back, then read to the end
+	for($i = 0; $i < 30 && av_stream_read_image($strm, $image, $time); $i++) {
+		$frames[] = array($time, imagecolorat($image, 4, 4), imagecolorat($image, 160, 120));
+	}
+	av_file_seek($file, 0.5);
+	while(av_stream_read_image($strm, $image, $time)) {
+		$frames[] = array($time, imagecolorat($image, 4, 4), imagecolorat($image, 160, 120));
+	}
+	av_file_close($file);
+	return $frames;
+}
+
+// reading ahead on another thread has to give the same frames as reading synchronously
+$expected = read_frames(array());
+$prefetched = read_frames(array("prefetch" => 16));
+if(count($prefetched) != count($expected)) {
+	echo "Read " . count($prefetched) . " frames instead of " . count($expected) . "\n";
+}
+foreach($expected as $index => $frame) {
+	if(!isset($prefetched[$index])) {
+		break;
+	}
+	if($prefetched[$index][0] != $frame[0]) {
+		echo "Frame $index: time {$prefetched[$index][0]} instead of $frame[0]\n";
+	} else if($prefetched[$index] != $frame) {
+		echo "Frame $index: pixels differ\n";
+	}
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
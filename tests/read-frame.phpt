@@ -0,0 +1,56 @@
+--TEST--
+Raw frame read test
+--SKIPIF--
+<?php
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+require("helpers.php");
+
+$folder = dirname(__FILE__);
+$filename = "test-read-frame.mp4";
+
+$testVideo = new TestVideo("$folder/$filename", 320, 240, 24, 1.0);
+$testVideo->setAudioCodec(false);
+$testVideo->create();
+
+$file = av_file_open("$folder/$filename", "r");
+$strm = av_stream_open($file, "video");
+
+// as decoded
+$frame = av_stream_read_frame($strm);
+echo "$frame[pix_fmt] $frame[width]x$frame[height] ", count($frame['planes']), "\n";
+foreach($frame['planes'] as $index => $plane) {
+	echo strlen($plane), " ", $frame['linesizes'][$index], "\n";
+}
+
+// converted
+$frame = av_stream_read_frame($strm, array("pix_fmt" => "rgb24", "width" => 160, "height" => 120));
+echo "$frame[pix_fmt] $frame[width]x$frame[height] ", count($frame['planes']), "\n";
+echo strlen($frame['planes'][0]), " ", $frame['linesizes'][0], "\n";
+
+$frame = av_stream_read_frame($strm, array("pix_fmt" => "gray"));
+echo "$frame[pix_fmt] $frame[width]x$frame[height] ", count($frame['planes']), "\n";
+
+$count = 3;
+while(av_stream_read_frame($strm)) {
+	$count++;
+}
+echo "$count\n";
+
+av_file_close($file);
+unlink("$folder/$filename");
+
+?>
+--EXPECT--
+yuv420p 320x240 3
+76800 320
+19200 160
+19200 160
+rgb24 160x120 1
+57600 480
+gray 320x240 1
+24
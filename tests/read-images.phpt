@@ -0,0 +1,54 @@
+--TEST--
+Batch image read test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+require("helpers.php");
+
+$folder = dirname(__FILE__);
+$filename = "test-read-images.mp4";
+
+$testVideo = new TestVideo("$folder/$filename", 320, 240, 24, 2.0);
+$testVideo->setAudioCodec(false);
+$testVideo->create();
+
+$file = av_file_open("$folder/$filename", "r");
+$strm = av_stream_open($file, "video");
+
+// fill an array of images
+$images = array();
+for($i = 0; $i < 5; $i++) {
+	$images[] = imagecreatetruecolor(160, 120);
+}
+$times = av_stream_read_images($strm, $images);
+echo count($times), "\n";
+
+// reuse a single image, stopping when the callback returns false
+$calls = 0;
+$image = imagecreatetruecolor(160, 120);
+$times = av_stream_read_images($strm, $image, function($img, $time) use(&$calls) {
+	$calls++;
+	return ($calls < 3);
+});
+echo count($times), " ", $calls, "\n";
+
+// reuse a single image for a fixed number of frames
+$times = av_stream_read_images($strm, $image, null, 4);
+echo count($times), "\n";
+
+av_file_close($file);
+$testVideo->delete();
+
+echo "OK\n";
+
+?>
+--EXPECT--
+5
+3 3
+4
+OK
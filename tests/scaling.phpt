@@ -0,0 +1,49 @@
+--TEST--
+Scaling algorithm test
+--SKIPIF--
+<?php
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-scaling.mp4";
+
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24, "scaling" => "lanczos", "accurate_rounding" => true));
+$image = imagecreatetruecolor(320, 240);
+imagefilledrectangle($image, 0, 0, 320, 240, imagecolorallocate($image, 200, 40, 40));
+for($i = 0; $i < 24; $i++) {
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+
+$thumbnail = imagecreatetruecolor(80, 60);
+foreach(array("fast_bilinear", "bilinear", "bicubic", "point", "area", "lanczos", "spline") as $scaling) {
+	$file = av_file_open($path, "r");
+	$strm = av_stream_open($file, "video", array("scaling" => $scaling, "full_chroma" => true));
+	$count = 0;
+	while(av_stream_read_image($strm, $thumbnail, $time)) {
+		$count++;
+	}
+	$rgb = imagecolorat($thumbnail, 40, 30);
+	$red = ($rgb >> 16) & 0xFF;
+	if($count != 24 || abs($red - 200) > 16) {
+		echo "$scaling: $count frames, red = $red\n";
+	}
+	av_file_close($file);
+}
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video", array("scaling" => "nearest"));
+av_file_close($file);
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECTF--
+Warning: av_stream_open(): 'nearest' is not a recognized scaling algorithm in %s on line %d
+OK
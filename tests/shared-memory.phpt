@@ -0,0 +1,103 @@
+--TEST--
+Shared memory frame test
+--SKIPIF--
+<?php
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+	if(!is_dir('/dev/shm')) print 'skip POSIX shared memory not available';
+?>
+--FILE--
+<?php
+
+require("helpers.php");
+
+$folder = dirname(__FILE__);
+$filename = "test-shared-memory.mp4";
+$name = "/av-test-" . getmypid();
+
+$testVideo = new TestVideo("$folder/$filename", 320, 240, 24, 1.0);
+$testVideo->setAudioCodec(false);
+$testVideo->create();
+
+$file1 = av_file_open("$folder/$filename", "r");
+$strm1 = av_stream_open($file1, "video");
+$file2 = av_file_open("$folder/$filename", "r");
+$strm2 = av_stream_open($file2, "video", array("shared_memory" => $name, "shared_memory_slots" => 4));
+
+for($i = 0; $i < 6; $i++) {
+	$frame1 = av_stream_read_frame($strm1, array("pix_fmt" => "gray"));
+	$frame2 = av_stream_read_frame($strm2, array("pix_fmt" => "gray"));
+
+	// map the frame the way another process would
+	$memory = file_get_contents("/dev/shm$name");
+	$header = unpack("Vmagic/Vversion/Vslot_count/Vheader_size", $memory);
+	$sequence = unpack("V", substr($memory, 32 + (($frame2['generation'] - 1) % 4) * 64, 4));
+	if($header['magic'] != 0x4d535641 || $header['slot_count'] != 4 || $sequence[1] != $frame2['generation'] * 2) {
+		echo "Bad header\n";
+	}
+	$linesize = $frame2['linesizes'][0];
+	for($y = 0; $y < 240; $y++) {
+		$row1 = substr($frame1['planes'][0], $y * 320, 320);
+		$row2 = substr($memory, $frame2['offset'] + $frame2['plane_offsets'][0] + $y * $linesize, 320);
+		if($row1 != $row2) {
+			echo "Frame $i differs at row $y\n";
+			break;
+		}
+	}
+	echo "$frame2[generation] $frame2[offset]\n";
+}
+
+// frames in the codec's own format are copied straight into the slot
+$file4 = av_file_open("$folder/$filename", "r");
+$strm4 = av_stream_open($file4, "video");
+$file5 = av_file_open("$folder/$filename", "r");
+$strm5 = av_stream_open($file5, "video", array("shared_memory" => "$name-native", "shared_memory_slots" => 2));
+for($i = 0; $i < 3; $i++) {
+	$frame4 = av_stream_read_frame($strm4);
+	$frame5 = av_stream_read_frame($strm5);
+	$memory = file_get_contents("/dev/shm$name-native");
+	if(count($frame5['plane_offsets']) != 3 || count($frame4['planes']) != 3) {
+		echo "Native frame $i has the wrong number of planes\n";
+		break;
+	}
+	foreach($frame4['planes'] as $plane => $data) {
+		$width = $frame4['linesizes'][$plane];
+		$rows = strlen($data) / $width;
+		for($y = 0; $y < $rows; $y++) {
+			$row4 = substr($data, $y * $width, $width);
+			$row5 = substr($memory, $frame5['offset'] + $frame5['plane_offsets'][$plane] + $y * $frame5['linesizes'][$plane], $width);
+			if($row4 != $row5) {
+				echo "Native frame $i differs at row $y of plane $plane\n";
+				break 2;
+			}
+		}
+	}
+}
+av_file_close($file4);
+av_file_close($file5);
+
+// a region that already exists is left alone
+$file3 = av_file_open("$folder/$filename", "r");
+$strm3 = av_stream_open($file3, "video", array("shared_memory" => $name));
+var_dump(av_stream_read_frame($strm3, array("pix_fmt" => "gray")));
+$strm3 = av_stream_open($file3, "video", array("shared_memory" => "/av/test"));
+av_file_close($file3);
+
+av_file_close($file1);
+av_file_close($file2);
+var_dump(file_exists("/dev/shm$name"));
+unlink("$folder/$filename");
+
+?>
+--EXPECTF--
+1 4096
+2 81920
+3 159744
+4 237568
+5 4096
+6 81920
+
+Warning: av_stream_read_frame(): Shared memory '/av-test-%d' already exists in %s on line %d
+bool(false)
+
+Warning: av_stream_open(): Shared memory name must start with '/' and contain no other '/' in %s on line %d
+bool(false)
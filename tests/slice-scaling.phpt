@@ -0,0 +1,59 @@
+--TEST--
+Slice-parallel scaling test
+--SKIPIF--
+<?php
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--INI--
+av.max_threads_per_stream=4
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-slice-scaling.mp4";
+
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 640, "height" => 480, "frame_rate" => 24, "scaling_threads" => 4));
+$image = imagecreatetruecolor(640, 480);
+for($y = 0; $y < 480; $y += 40) {
+	imagefilledrectangle($image, 0, $y, 640, $y + 39, imagecolorallocate($image, $y / 2, 255 - $y / 2, 128));
+}
+for($i = 0; $i < 12; $i++) {
+	av_stream_write_image($strm, $image, ($i + 0.5) / 24);
+}
+av_file_close($file);
+
+// decode the same frame with and without slicing and compare
+$whole = imagecreatetruecolor(320, 240);
+$sliced = imagecreatetruecolor(320, 240);
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video");
+av_stream_read_image($strm, $whole, $time);
+av_file_close($file);
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video", array("scaling_threads" => 4));
+av_stream_read_image($strm, $sliced, $time);
+av_file_close($file);
+
+// each slice is scaled at the whole frame's ratio, with margins, so the results should match
+$difference = 0;
+for($y = 0; $y < 240; $y++) {
+	for($x = 0; $x < 320; $x += 3) {
+		$a = imagecolorat($whole, $x, $y);
+		$b = imagecolorat($sliced, $x, $y);
+		for($shift = 0; $shift < 24; $shift += 8) {
+			$difference = max($difference, abs((($a >> $shift) & 0xFF) - (($b >> $shift) & 0xFF)));
+		}
+	}
+}
+if($difference > 1) {
+	echo "Maximum difference: $difference\n";
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,40 @@
+--TEST--
+Thumbnail extraction test
+--SKIPIF--
+<?php 
+	if(!function_exists('imagecreatetruecolor')) print 'skip GD not available';
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+require("helpers.php");
+
+$folder = dirname(__FILE__);
+$filename = "test-thumbnails.mp4";
+
+$testVideo = new TestVideo("$folder/$filename", 320, 240, 24, 5.0);
+$testVideo->setAudioCodec(false);
+$testVideo->create();
+
+$file = av_file_open("$folder/$filename", "r");
+$strm = av_stream_open($file, "video");
+
+$result = av_file_extract_thumbnails($file, 4, 80, 60, array("precise" => true));
+echo count($result['images']), " ", count($result['times']), " ", count($result['timings']), "\n";
+echo imagesx($result['images'][0]), "x", imagesy($result['images'][0]), "\n";
+
+$result = av_file_extract_thumbnails($file, 4, 80, 60, array("sprite" => 2));
+echo imagesx($result['sprite']), "x", imagesy($result['sprite']), "\n";
+
+av_file_close($file);
+$testVideo->delete();
+
+echo "OK\n";
+
+?>
+--EXPECT--
+4 4 4
+80x60
+160x120
+OK
@@ -0,0 +1,71 @@
+--TEST--
+Waveform test
+--SKIPIF--
+<?php
+	if(!in_array('flac', av_get_encoders())) print 'skip FLAC encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-waveform.flac";
+
+// four seconds, getting louder each second
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "audio", array("sampling_rate" => 44100, "channels" => 2));
+$samples = '';
+for($i = 0; $i < 44100 * 4; $i++) {
+	$value = sin($i * 440 * 2 * M_PI / 44100) * (floor($i / 44100) + 1) * 0.2;
+	$samples .= pack("ff", $value, $value / 2);
+}
+av_stream_write_pcm($strm, $samples);
+av_file_close($file);
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "audio");
+$waveform = av_stream_waveform($strm, 4, array("rms" => true));
+av_file_close($file);
+
+if($waveform['channels'] != 2 || count($waveform['max'][0]) != 4 || count($waveform['rms'][1]) != 4) {
+	print_r($waveform);
+}
+for($i = 0; $i < 4; $i++) {
+	$expected = ($i + 1) * 0.2;
+	if(abs($waveform['max'][0][$i] - $expected) > 0.05 || abs($waveform['min'][0][$i] + $expected) > 0.05) {
+		echo "Bucket $i: {$waveform['min'][0][$i]} {$waveform['max'][0][$i]}\n";
+	}
+	if(abs($waveform['max'][1][$i] - $expected / 2) > 0.05) {
+		echo "Bucket $i, channel 1: {$waveform['max'][1][$i]}\n";
+	}
+	if(abs($waveform['rms'][0][$i] - $expected / sqrt(2)) > 0.05) {
+		echo "Bucket $i RMS: {$waveform['rms'][0][$i]}\n";
+	}
+}
+
+// the binary form holds the same values
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "audio");
+$binary = av_stream_waveform($strm, 4, array("binary" => true));
+av_file_close($file);
+$maxs = array_values(unpack("f*", $binary['max']));
+for($i = 0; $i < 4; $i++) {
+	if(abs($maxs[$i * 2] - $waveform['max'][0][$i]) > 0.0001) {
+		echo "Binary bucket $i: {$maxs[$i * 2]}\n";
+	}
+}
+
+// sampling a part of each bucket
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "audio");
+$sampled = av_stream_waveform($strm, 4, array("sample_duration" => 0.25));
+av_file_close($file);
+if(count($sampled['max'][0]) != 4 || $sampled['max'][0][3] < $sampled['max'][0][0]) {
+	print_r($sampled);
+}
+unlink($path);
+
+echo "OK\n";
+
+?>
+--EXPECT--
+OK
@@ -0,0 +1,65 @@
+--TEST--
+Raw frame write test
+--SKIPIF--
+<?php
+	if(!in_array('mpeg4', av_get_encoders())) print 'skip MP4 encoder not avilable';
+?>
+--FILE--
+<?php
+
+$folder = dirname(__FILE__);
+$path = "$folder/test-write-frame.mp4";
+
+$file = av_file_open($path, "w");
+$strm = av_stream_open($file, "video", array("width" => 320, "height" => 240, "frame_rate" => 24));
+for($i = 0; $i < 24; $i++) {
+	$time = ($i + 0.5) / 24;
+	switch($i % 3) {
+		case 0:
+			// same format and size as the codec, as one buffer
+			$y = str_repeat(chr(128), 320 * 240);
+			$u = str_repeat(chr(90), 160 * 120);
+			$v = str_repeat(chr(170), 160 * 120);
+			av_stream_write_frame($strm, $y . $u . $v, null, $time);
+			break;
+		case 1:
+			// separate planes with padded rows
+			$y = str_repeat(str_repeat(chr(128), 320) . str_repeat("\0", 64), 240);
+			$u = str_repeat(str_repeat(chr(90), 160) . str_repeat("\0", 32), 120);
+			$v = str_repeat(str_repeat(chr(170), 160) . str_repeat("\0", 32), 120);
+			av_stream_write_frame($strm, array($y, $u, $v), array("linesizes" => array(384, 192, 192)), $time);
+			break;
+		case 2:
+			// packed RGBA at a different size, the same color in BT.601
+			$rgba = str_repeat("\xc5\x6f\x36\xff", 160 * 120);
+			av_stream_write_frame($strm, $rgba, array("pix_fmt" => "rgba", "width" => 160, "height" => 120), $time);
+			break;
+	}
+}
+av_stream_write_frame($strm, "too short", null);
+av_file_close($file);
+
+$file = av_file_open($path, "r");
+$strm = av_stream_open($file, "video");
+$count = 0;
+$maximum = 0;
+while($frame = av_stream_read_frame($strm, array("pix_fmt" => "yuv420p"))) {
+	$count++;
+	foreach(array(128, 90, 170) as $index => $expected) {
+		$plane = $frame['planes'][$index];
+		for($i = 0; $i < strlen($plane); $i += 997) {
+			$maximum = max($maximum, abs(ord($plane[$i]) - $expected));
+		}
+	}
+}
+echo "$count\n";
+if($maximum > 8) {
+	echo "Maximum deviation: $maximum\n";
+}
+av_file_close($file);
+unlink($path);
+
+?>
+--EXPECTF--
+Warning: av_stream_write_frame(): Buffer is too small--115200 bytes are needed in %s on line %d
+24